@@ -0,0 +1,198 @@
+/* Stress benchmark for QUEUE_DEFINE queues and the pointer-based Queue.
+ * Pushes and pops the given number of values (default 10 million) in bursts
+ * of varying size, single and batched, so the ring wraps around and grows
+ * many times. Every value popped is checked against the order it was pushed
+ * in; the benchmark exits with status 1 if any comes out wrong. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h> // intptr_t
+#include <time.h>   // clock_gettime()
+#include "queue.h"
+
+QUEUE_DEFINE(IntQueue, int)
+
+#define BENCH_DEFAULT_OPS (10 * 1000 * 1000)
+#define BENCH_MAX_BURST   4096
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Pseudo-random burst sizes, the same on every run
+static unsigned next_burst(unsigned *state) {
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) % BENCH_MAX_BURST + 1;
+}
+
+static int fail(const char *what, int expected, int got) {
+    fprintf(stderr, "queue_bench: %s: expected %d, got %d\n", what, expected,
+            got);
+    return 1;
+}
+
+/* Push bursts one value at a time and pop slightly smaller ones, so the
+ * queue drifts upwards in size while its front keeps wrapping. */
+static int single(long ops) {
+    IntQueue queue;
+    if (init_IntQueue(&queue, 0)) {
+        return fail("init", 0, 1);
+    }
+    unsigned state = 1;
+    int pushed = 0, popped = 0, val;
+    long done = 0;
+    while (done < ops) {
+        unsigned burst = next_burst(&state);
+        for (unsigned i = 0; i < burst; i++) {
+            if (push_IntQueue(&queue, pushed++)) {
+                return fail("push", 0, 1);
+            }
+        }
+        for (unsigned i = 0; i < burst - burst / 8; i++) {
+            if (pop_IntQueue(&queue, &val) || val != popped++) {
+                return fail("pop", popped - 1, val);
+            }
+        }
+        done += 2 * burst - burst / 8;
+    }
+    while (size_IntQueue(&queue) > 0) {
+        if (pop_IntQueue(&queue, &val) || val != popped++) {
+            return fail("drain", popped - 1, val);
+        }
+    }
+    if (pushed != popped || !pop_IntQueue(&queue, &val)) {
+        return fail("empty", pushed, popped);
+    }
+    free_IntQueue(&queue);
+    return 0;
+}
+
+// The same pattern with push_n and pop_n, starting from a tiny ring
+static int batch(long ops) {
+    IntQueue queue;
+    int *vals = malloc(BENCH_MAX_BURST * sizeof(*vals));
+    if (vals == NULL || init_IntQueue(&queue, 1)) {
+        return fail("init", 0, 1);
+    }
+    unsigned state = 2;
+    int pushed = 0, popped = 0;
+    long done = 0;
+    while (done < ops) {
+        unsigned burst = next_burst(&state);
+        for (unsigned i = 0; i < burst; i++) {
+            vals[i] = pushed++;
+        }
+        if (push_n_IntQueue(&queue, vals, burst)) {
+            return fail("push_n", 0, 1);
+        }
+        unsigned count = burst - burst / 8;
+        if (pop_n_IntQueue(&queue, vals, count)) {
+            return fail("pop_n", 0, 1);
+        }
+        for (unsigned i = 0; i < count; i++) {
+            if (vals[i] != popped++) {
+                return fail("pop_n", popped - 1, vals[i]);
+            }
+        }
+        done += 2 * burst - burst / 8;
+    }
+    // Asking for more than there is pops nothing
+    int size = size_IntQueue(&queue);
+    if (!pop_n_IntQueue(&queue, vals, size + 1) ||
+        size_IntQueue(&queue) != size) {
+        return fail("pop_n past the end", size, size_IntQueue(&queue));
+    }
+    free(vals);
+    free_IntQueue(&queue);
+    return 0;
+}
+
+#define BOX(val)   ((const void*)(intptr_t)(val))
+#define UNBOX(ptr) ((int)(intptr_t)(ptr))
+
+/* Queue, with values boxed as pointers. Bursts alternate between single
+ * and batch operations, so each kind sees the other's wrapped rings. */
+static int boxed(long ops) {
+    const Queue *queue = new_Queue(1);
+    const void **vals = malloc(BENCH_MAX_BURST * sizeof(*vals));
+    if (queue == NULL || vals == NULL) {
+        return fail("init", 0, 1);
+    }
+    unsigned state = 3;
+    int pushed = 0, popped = 0;
+    const void *val;
+    long done = 0;
+    for (int round = 0; done < ops; round++) {
+        unsigned burst = next_burst(&state);
+        unsigned count = burst - burst / 8;
+        if (round % 2 == 0) {
+            for (unsigned i = 0; i < burst; i++) {
+                if (queue->push(queue, BOX(pushed++))) {
+                    return fail("push", 0, 1);
+                }
+            }
+            if (queue->pop_n(queue, vals, count)) {
+                return fail("pop_n", 0, 1);
+            }
+            for (unsigned i = 0; i < count; i++) {
+                if (UNBOX(vals[i]) != popped++) {
+                    return fail("pop_n", popped - 1, UNBOX(vals[i]));
+                }
+            }
+        } else {
+            for (unsigned i = 0; i < burst; i++) {
+                vals[i] = BOX(pushed++);
+            }
+            if (queue->push_n(queue, vals, burst)) {
+                return fail("push_n", 0, 1);
+            }
+            for (unsigned i = 0; i < count; i++) {
+                if (queue->pop(queue, &val) || UNBOX(val) != popped++) {
+                    return fail("pop", popped - 1, UNBOX(val));
+                }
+            }
+        }
+        done += 2 * burst - burst / 8;
+    }
+    while (queue->size(queue) > 0) {
+        if (queue->front(queue, &val) || UNBOX(val) != popped ||
+            queue->pop(queue, &val) || UNBOX(val) != popped++) {
+            return fail("drain", popped - 1, UNBOX(val));
+        }
+    }
+    if (pushed != popped || !queue->pop(queue, &val) || val != NULL) {
+        return fail("empty", pushed, popped);
+    }
+    free(vals);
+    queue->free(queue, NULL);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long ops = argc > 1 ? strtol(argv[1], NULL, 10) : BENCH_DEFAULT_OPS;
+    if (ops <= 0) {
+        fprintf(stderr, "usage: %s [operations]\n", argv[0]);
+        return 2;
+    }
+    double start = now();
+    if (single(ops)) {
+        return 1;
+    }
+    double middle = now();
+    if (batch(ops)) {
+        return 1;
+    }
+    double end = now();
+    if (boxed(ops)) {
+        return 1;
+    }
+    double last = now();
+    printf("single: %ld ops in %.3fs, %.1f Mops/s\n", ops, middle - start,
+           ops / (middle - start) / 1e6);
+    printf("batch:  %ld ops in %.3fs, %.1f Mops/s\n", ops, end - middle,
+           ops / (end - middle) / 1e6);
+    printf("Queue:  %ld ops in %.3fs, %.1f Mops/s\n", ops, last - end,
+           ops / (last - end) / 1e6);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h> // size_t
+
+#define ARENA_CHUNK_SIZE     (64 * 1024)
+#define ARENA_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+#define ARENA_ALIGNMENT      8
+
+typedef struct arena Arena;
+
+/* Bump allocator owning every allocation made for one translation unit.
+ * Memory is carved out of large chunks which grow geometrically, and is only
+ * ever released all at once by free(). */
+struct arena {
+    void *data;
+    void   *(*alloc) (const Arena *this, size_t size);
+    char   *(*strdup)(const Arena *this, const char *str);
+    size_t  (*used)  (const Arena *this);
+    void    (*free)  (const Arena *this);
+};
+
+const Arena *new_Arena(size_t chunk_size);
+
+#endif//ARENA_H
@@ -0,0 +1,32 @@
+#ifndef ASMGEN_H
+#define ASMGEN_H
+
+#include "ir.h"
+#include "writer.h"
+
+/* x86-64 code generation from the IR, as GNU as assembly for the System V
+ * ABI. Like the C backend (codegen.h), all the files of a program become one
+ * assembly file, which the system C compiler assembles and links with libc:
+ *
+ *   asmgen_prelude()            the print functions every program needs
+ *   asmgen_unit() per file      the file's globals, t_run_<unit> running
+ *                               its statements and t_print_<unit> printing
+ *                               its globals, in input order
+ *   asmgen_main()               main(), which runs every file's statements
+ *                               in order and then prints all the globals
+ *
+ * T variables are common symbols named v_<name>, shared by the files that
+ * assign them, and are printed like the C backend prints them. Within
+ * t_run_<unit> they live in registers, allocated by linear scan (see
+ * regalloc.h) together with the values the IR computes: a read of a
+ * variable uses the register holding its value, and each variable the file
+ * assigns reaches memory once, when it is last assigned, whatever the -O
+ * level. */
+
+void asmgen_prelude(Writer *out);
+/* unit numbers the files of the program from 0. Returns nonzero if out of
+ * memory, after which 'out' holds a partial unit. */
+int asmgen_unit(const IR *ir, int unit, Writer *out);
+void asmgen_main(int units, Writer *out);
+
+#endif//ASMGEN_H
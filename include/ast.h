@@ -2,120 +2,162 @@
 #define AST_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include "vector.h"
+#include "arena.h"
+#include "interner.h"
+#include "writer.h"
 
 #define JSON_TAB_WIDTH 4
 
-/* AST Node */
+struct YYLTYPE;
+
+/* Node kinds. The hierarchy is:
+ *   AST Node
+ *   |-- Leaf Node
+ *   |-- Program Node
+ *   `-- Statement Node
+ *       |-- Assignment Node
+ *       `-- RExpr Node
+ *           `-- LExpr Node
+ *               |-- Variable Node
+ *               |-- Int Node
+ *               `-- Double Node
+ */
+typedef enum ast_node_kind {
+    AST_LEAF,
+    AST_PROGRAM,
+    AST_ASSIGNMENT,
+    AST_VARIABLE,
+    AST_INT,
+    AST_DOUBLE,
+    AST_KIND_COUNT
+} ASTNodeKind;
+
+/* Source span of a node, copied out of the parser's YYLTYPE */
+typedef struct ast_location ASTLocation;
+struct ast_location {
+    int first_line;
+    int first_column;
+    int last_line;
+    int last_column;
+};
+
 typedef struct ast_node        ASTNode;
-typedef struct ast_node_data   ASTNodeData;
 typedef struct ast_node_vtable ASTNodeVTable;
-struct ast_node {
-    void *data;
-    void *vtable;
-};
-struct ast_node_data {
-    struct YYLTYPE *loc;
-};
+typedef struct ast_builder     ASTBuilder;
+typedef struct ast_flat        ASTFlat;     // See ast_flat.h
+typedef uint32_t               ASTRef;
+
+/* One static vtable exists per node kind; it is looked up from the node's
+ * kind tag rather than stored in the node. */
 struct ast_node_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
+    void           (*free)(const ASTNode*);
+    // The node's children in order, as visited by walk_ASTNode()
+    int            (*child_count)(const ASTNode*);
+    const ASTNode *(*child)(const ASTNode*, int slot);
+    /* JSON output comes in pieces so that the walker, not the C stack, does
+     * the nesting: json opens the node and writes its own fields, json_child
+     * starts the field holding a child and returns the child's indentation,
+     * and json_close ends the node. */
+    void           (*json)(const ASTNode*, int indent, Writer*);
+    int            (*json_child)(const ASTNode*, int slot, int indent,
+                                 Writer*);
+    void           (*json_close)(const ASTNode*, int indent, Writer*);
 };
-void free_ASTNode(const void*);
-
-
-/* Leaf Node */
-const ASTNode *new_LeafNode(struct YYLTYPE *loc);
 
 
 /* Program Node < AST Node */
-typedef struct ast_program_data   ASTProgramData;
-typedef struct ast_program_vtable ASTProgramVTable;
+typedef struct ast_program_data ASTProgramData;
 struct ast_program_data {
-    struct YYLTYPE *loc;
     const Vector *statements;
 };
-struct ast_program_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
-};
-const ASTNode *new_ProgramNode(struct YYLTYPE *loc, const Vector *statements);
-
-
-/* Statement Node < AST Node */
-typedef struct ast_statement_data   ASTStatementData;
-typedef struct ast_statement_vtable ASTStatementVTable;
-struct ast_statement_data {
-    struct YYLTYPE *loc;
-};
-struct ast_statement_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
-};
 
 
 /* Assignment Node < Statement Node */
-typedef struct ast_assignment_data   ASTAssignmentData;
-typedef struct ast_assignment_vtable ASTAssignmentVTable;
+typedef struct ast_assignment_data ASTAssignmentData;
 struct ast_assignment_data {
-    struct YYLTYPE *loc;
-    const void *lhs;
-    const void *rhs;
-};
-struct ast_assignment_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
-};
-const ASTNode *new_AssignmentNode(struct YYLTYPE *loc,
-                                  const void *lhs,
-                                  const void *rhs);
-
-/* RExpr Node < Statement Node */
-typedef struct ast_r_expr_data   ASTRExprData;
-typedef struct ast_r_expr_vtable ASTRExprVTable;
-struct ast_r_expr_data {
-    struct YYLTYPE *loc;
-};
-struct ast_r_expr_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
+    const ASTNode *lhs;
+    const ASTNode *rhs;
 };
 
-/* LExpr Node < RExpr Node */
-typedef struct ast_l_expr_data   ASTLExprData;
-typedef struct ast_l_expr_vtable ASTLExprVTable;
-struct ast_l_expr_data {
-    struct YYLTYPE *loc;
-};
-struct ast_l_expr_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
-};
 
 /* Variable Node < LExpr Node */
-typedef struct ast_variable_data   ASTVariableData;
-typedef struct ast_variable_vtable ASTVariableVTable;
+typedef struct ast_variable_data ASTVariableData;
 struct ast_variable_data {
-    struct YYLTYPE *loc;
-    char *name;
-};
-struct ast_variable_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
+    const Symbol *name;
 };
-const ASTNode *new_VariableNode(struct YYLTYPE *loc, char *name);
+
 
 /* Int Node < LExpr Node */
-typedef struct ast_int_data   ASTIntData;
-typedef struct ast_int_vtable ASTIntVTable;
+typedef struct ast_int_data ASTIntData;
 struct ast_int_data {
-    struct YYLTYPE *loc;
     int val;
 };
-struct ast_int_vtable {
-    void   (*free)(const void*);
-    void   (*json)(const void*, int, FILE*);
+
+
+/* Double Node < LExpr Node */
+typedef struct ast_double_data ASTDoubleData;
+struct ast_double_data {
+    double val;
 };
-const ASTNode *new_IntNode(struct YYLTYPE *loc, int val);
+
+
+/* AST Node. The kind-specific fields are stored inline, so a node is a
+ * single allocation and a walk never chases more than the child pointers. */
+struct ast_node {
+    ASTNodeKind kind;
+    ASTRef      ref;    // Handle of the node's copy in a flat AST, if any
+    ASTLocation loc;
+    union {
+        ASTProgramData    program;
+        ASTAssignmentData assignment;
+        ASTVariableData   variable;
+        ASTIntData        integer;
+        ASTDoubleData     real;
+    } data;
+};
+
+/* Where the new_*Node constructors put their nodes. Nodes are always built in
+ * the arena; if flat is non-NULL they are also appended to that flat AST and
+ * the resulting handle is stored in ASTNode.ref. Identifiers are interned in
+ * interner, which shares the arena. */
+struct ast_builder {
+    const Arena    *arena;
+    ASTFlat        *flat;
+    const Interner *interner;
+};
+
+const ASTNodeVTable *vtable_ASTNode(const ASTNode *node);
+/* Free what the tree under node holds outside its arena: the statement
+ * list of a Program. node must be the root, since that is the only place a
+ * Program appears. */
+void free_ASTNode(const void *node);
+// Returns nonzero if the walk ran out of memory
+int json_ASTNode(const ASTNode *node, int indent, Writer *out);
+
+/* Shared by the JSON dumps of both AST backends: open a node's object with
+ * its type and location fields, and close it again. */
+void json_open_node(const char *type, const ASTLocation *loc, int indent,
+                    Writer *out);
+void json_close_node(int indent, Writer *out);
+
+const ASTNode *new_LeafNode(const ASTBuilder *builder, struct YYLTYPE *loc);
+const ASTNode *new_ProgramNode(const ASTBuilder *builder,
+                               struct YYLTYPE *loc,
+                               const Vector *statements);
+const ASTNode *new_AssignmentNode(const ASTBuilder *builder,
+                                  struct YYLTYPE *loc,
+                                  const ASTNode *lhs,
+                                  const ASTNode *rhs);
+const ASTNode *new_VariableNode(const ASTBuilder *builder,
+                                struct YYLTYPE *loc,
+                                const Symbol *name);
+const ASTNode *new_IntNode(const ASTBuilder *builder,
+                           struct YYLTYPE *loc,
+                           int val);
+const ASTNode *new_DoubleNode(const ASTBuilder *builder,
+                              struct YYLTYPE *loc,
+                              double val);
 
 #endif//AST_H
@@ -0,0 +1,63 @@
+#ifndef AST_BIN_H
+#define AST_BIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ast_flat.h"
+
+/* Binary AST files. The file is a header followed by the flat AST's arrays,
+ * each padded to AST_BIN_ALIGNMENT:
+ *
+ *   locs[kind]     ASTLocation[counts[kind]], for every kind in order
+ *   programs       FlatProgram[counts[AST_PROGRAM]]
+ *   assignments    FlatAssignment[counts[AST_ASSIGNMENT]]
+ *   variables      FlatVariable[counts[AST_VARIABLE]]
+ *   ints           FlatInt[counts[AST_INT]]
+ *   doubles        FlatDouble[counts[AST_DOUBLE]]
+ *   children       ASTRef[children_size]
+ *   strings        char[strings_size]
+ *
+ * Values are in the byte order of the machine that wrote the file, which is
+ * recorded in byte_order. Since the flat AST holds no pointers, a loaded file
+ * is used in place: the arrays of an ASTBin point straight into the mapping.
+ * Readers must reject files whose version they don't know. */
+
+#define AST_BIN_MAGIC      "TAST"
+#define AST_BIN_VERSION    2     // 2: added Double nodes
+#define AST_BIN_BYTE_ORDER UINT32_C(0x01020304)
+#define AST_BIN_ALIGNMENT  8
+#define AST_BIN_SUFFIX     ".astb"  // Inputs named so are read as binary ASTs
+
+typedef struct ast_bin_header ASTBinHeader;
+
+struct ast_bin_header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    ASTRef   root;
+    uint32_t counts[AST_KIND_COUNT];    // Number of nodes of each kind
+    uint32_t children_size;
+    uint32_t strings_size;
+};
+
+typedef struct ast_bin ASTBin;
+
+/* A loaded binary AST. flat can be read with the usual flat AST accessors,
+ * such as json_ASTFlat(), but must not be modified or passed to
+ * free_ASTFlat(); release it with free_ASTBin() instead. */
+struct ast_bin {
+    ASTFlat flat;
+    ASTRef  root;
+    void    *map;
+    size_t  size;
+};
+
+// Returns nonzero, with errno set, if the file could not be written
+int write_ASTBin(const ASTFlat *flat, ASTRef root, FILE *out);
+/* Returns NULL, with errno set, on failure; EINVAL if the file is
+ * malformed. Every handle, child range and name offset is checked, and the
+ * tree must be acyclic, so a loaded file is safe to walk. */
+ASTBin *load_ASTBin(const char *filename);
+void free_ASTBin(ASTBin *bin);
+
+#endif//AST_BIN_H
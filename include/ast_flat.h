@@ -0,0 +1,89 @@
+#ifndef AST_FLAT_H
+#define AST_FLAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ast.h"
+
+/* Flat AST backend. Nodes live in one contiguous array per node kind and are
+ * addressed by 32-bit handles; child lists are ranges into a shared handle
+ * buffer and names are offsets into a string table. Nothing in the tree is a
+ * pointer, so it can be copied, written out or relocated as plain bytes. */
+
+#define AST_FLAT_CAPACITY  64
+#define AST_REF_KIND_BITS  4
+#define AST_REF_INDEX_BITS (32 - AST_REF_KIND_BITS)
+#define AST_REF_INDEX_MASK ((UINT32_C(1) << AST_REF_INDEX_BITS) - 1)
+#define AST_REF_NONE       UINT32_MAX
+
+/* A node handle: the node kind in the top bits, the index into that kind's
+ * array in the rest. */
+#define AST_REF(kind, index) \
+    (((ASTRef)(kind) << AST_REF_INDEX_BITS) | (ASTRef)(index))
+#define AST_REF_KIND(ref)  ((ASTNodeKind)((ref) >> AST_REF_INDEX_BITS))
+#define AST_REF_INDEX(ref) ((ref) & AST_REF_INDEX_MASK)
+
+typedef struct flat_program    FlatProgram;
+typedef struct flat_assignment FlatAssignment;
+typedef struct flat_variable   FlatVariable;
+typedef struct flat_int        FlatInt;
+typedef struct flat_double     FlatDouble;
+
+struct flat_program {
+    uint32_t first;     // Index of the first statement in ASTFlat.children
+    uint32_t count;
+};
+struct flat_assignment {
+    ASTRef lhs;
+    ASTRef rhs;
+};
+struct flat_variable {
+    uint32_t name;      // Offset of the name in ASTFlat.strings
+};
+struct flat_int {
+    int32_t val;
+};
+struct flat_double {
+    double val;
+};
+
+struct ast_flat {
+    FlatProgram    *programs;
+    FlatAssignment *assignments;
+    FlatVariable   *variables;
+    FlatInt        *ints;
+    FlatDouble     *doubles;
+    ASTLocation    *locs[AST_KIND_COUNT];
+    uint32_t       sizes[AST_KIND_COUNT];
+    uint32_t       capacities[AST_KIND_COUNT];
+    ASTRef         *children;
+    uint32_t       children_size;
+    uint32_t       children_capacity;
+    char           *strings;
+    uint32_t       strings_size;
+    uint32_t       strings_capacity;
+    uint32_t       *name_offsets;   // Symbol id -> offset in strings
+    uint32_t       name_offsets_capacity;
+};
+
+ASTFlat *new_ASTFlat(void);
+void free_ASTFlat(ASTFlat *flat);
+// Returns nonzero if it ran out of memory
+int json_ASTFlat(const ASTFlat *flat, ASTRef ref, int indent, Writer *out);
+
+ASTRef flat_add_leaf(ASTFlat *flat, const ASTLocation *loc);
+ASTRef flat_add_program(ASTFlat *flat,
+                        const ASTLocation *loc,
+                        const ASTRef *statements,
+                        uint32_t count);
+ASTRef flat_add_assignment(ASTFlat *flat,
+                           const ASTLocation *loc,
+                           ASTRef lhs,
+                           ASTRef rhs);
+ASTRef flat_add_variable(ASTFlat *flat,
+                         const ASTLocation *loc,
+                         const Symbol *name);
+ASTRef flat_add_int(ASTFlat *flat, const ASTLocation *loc, int val);
+ASTRef flat_add_double(ASTFlat *flat, const ASTLocation *loc, double val);
+
+#endif//AST_FLAT_H
@@ -0,0 +1,43 @@
+#ifndef AST_WALK_H
+#define AST_WALK_H
+
+#include "ast.h"
+#include "stack.h"
+
+/* Iterative depth-first traversal of the pointer AST. The path from the root
+ * to the current node is kept in an explicit stack of frames rather than on
+ * the C stack, so arbitrarily deep trees (long a = b = c = ... chains) are
+ * walked in constant native stack space. */
+
+typedef struct ast_walk_frame ASTWalkFrame;
+
+struct ast_walk_frame {
+    const ASTNode *node;
+    int           slot;     // Position among the parent's children
+    int           next;     // Next child to visit
+    int           count;    // Children to visit; 0 once they are skipped
+    int           data;     // Free for the callbacks, e.g. an indentation
+};
+
+STACK_DEFINE(ASTWalkStack, ASTWalkFrame)
+
+/* Callbacks get the node's frame and its parent's frame, NULL for the root;
+ * both stay valid until the callback returns. enter is called before the
+ * node's children are visited, and can skip them by returning nonzero. leave
+ * is called after them. Either callback may be NULL. */
+typedef int  (*ASTWalkEnter)(ASTWalkFrame *frame, ASTWalkFrame *parent,
+                             void *ctx);
+typedef void (*ASTWalkLeave)(ASTWalkFrame *frame, ASTWalkFrame *parent,
+                             void *ctx);
+
+/* Walk the tree under root. 'stack' is scratch space that callers doing many
+ * walks can initialize once and reuse; if it is NULL the walk allocates its
+ * own. Returns nonzero if the stack could not be grown, in which case the
+ * walk stops early. */
+int walk_ASTNode(const ASTNode *root,
+                 ASTWalkEnter enter,
+                 ASTWalkLeave leave,
+                 void *ctx,
+                 ASTWalkStack *stack);
+
+#endif//AST_WALK_H
@@ -0,0 +1,69 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include "ir.h"
+#include "map.h"
+#include "vector.h"
+
+/* Register-based bytecode, lowered from the IR and run by the VM in vm.h.
+ *
+ * Every T variable is a register, as is every load that the IR can't fold
+ * into its user, and the checker has already given each one a fixed type,
+ * so registers hold unboxed ints or doubles with no type tags. Instructions
+ * are a fixed 8 bytes: an opcode, the destination register a, and an
+ * operand b whose meaning depends on the opcode.
+ *
+ * Files are lowered to bytecode on their own, with registers numbered per
+ * file, and then linked into one program in input order. Linking gives
+ * every global name a single register, so the files share their variables
+ * like they do in the generated C. */
+
+typedef enum opcode {
+    OP_HALT,        // Stop; must end every program
+    OP_INT,         // a = b, an int32_t
+    OP_DOUBLE,      // a = constants[b]
+    OP_MOVE,        // a = register b, of the same type
+    OP_COUNT
+} Opcode;
+
+#define BYTECODE_MAX_REGISTERS (1 << 24)
+
+typedef struct instruction {
+    uint32_t op : 8;
+    uint32_t a  : 24;
+    uint32_t b;
+} Instruction;
+
+typedef struct bytecode_register {
+    char *name;         // NULL for temporaries
+    Type type;
+} BytecodeRegister;
+
+VECTOR_DEFINE(Instructions, Instruction)
+VECTOR_DEFINE(BytecodeConstants, double)
+VECTOR_DEFINE(BytecodeRegisters, BytecodeRegister)
+
+/* A lowered file, or a linked program. Named registers are listed in the
+ * order in which they are first assigned, which is also the order the VM
+ * prints them in. */
+typedef struct bytecode {
+    Instructions      code;
+    BytecodeConstants constants;
+    BytecodeRegisters registers;
+    const Map         *names;   // Register name -> index + 1, for linking
+} Bytecode;
+
+Bytecode *new_Bytecode(void);
+void free_Bytecode(Bytecode *bytecode);
+
+/* Lower a file's IR into 'unit', which must be empty. Returns nonzero if
+ * out of memory or the file needs more registers than there are. */
+int lower_Bytecode(Bytecode *unit, const IR *ir);
+/* Append a lowered file to a program, merging registers by name. Returns
+ * nonzero if out of memory or out of registers. */
+int link_Bytecode(Bytecode *program, const Bytecode *unit);
+// Append the final OP_HALT; returns nonzero if out of memory
+int seal_Bytecode(Bytecode *program);
+
+#endif//BYTECODE_H
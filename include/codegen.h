@@ -0,0 +1,30 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ir.h"
+#include "writer.h"
+
+#define CODEGEN_TAB_WIDTH 4
+
+/* C code generation from the IR. All the files of a program become one C
+ * translation unit, fed to the system C compiler:
+ *
+ *   codegen_prelude()           the runtime support every program needs
+ *   codegen_unit() per file     the file's globals and two functions, one
+ *                               running its statements and one printing its
+ *                               globals, in input order
+ *   codegen_main()              main(), which runs every file's statements
+ *                               in order and then prints all the globals
+ *
+ * T variables become C globals of the same type, named v_<name>. They are
+ * zero-initialized, and since the files of a program share them, every file
+ * declares the globals it assigns; repeated tentative definitions are fine in
+ * C. When the program exits, each global is printed once, as "name = value",
+ * in the order in which the files first assign them. */
+
+void codegen_prelude(Writer *out);
+// unit numbers the files of the program from 0
+void codegen_unit(const IR *ir, int unit, Writer *out);
+void codegen_main(int units, Writer *out);
+
+#endif//CODEGEN_H
@@ -0,0 +1,35 @@
+#ifndef CONCURRENT_MAP_H
+#define CONCURRENT_MAP_H
+
+#include <stddef.h> // size_t
+
+typedef struct concurrent_map ConcurrentMap;
+
+#define CONCURRENT_MAP_CAPACITY 1024
+
+/* A thread-safe variant of Map for data shared between worker threads, such
+ * as the global symbols of all the files being compiled. Entries can only be
+ * added, never replaced or removed, which lets every operation be lock-free:
+ * lookups are plain atomic loads, and an insert publishes its entry with a
+ * single compare-and-swap.
+ *
+ * insert() returns 0 if the key was added, 1 if it was already present, in
+ * which case its value is stored in *existing_ptr unless that is NULL, and
+ * -1 if out of memory. Of several threads inserting the same key, exactly
+ * one adds it and the others see its value. get() returns 0 and stores the
+ * value if the key is present, 1 otherwise. free() must not run
+ * concurrently with anything else. */
+struct concurrent_map {
+    void *data;
+    int  (*insert)(const ConcurrentMap*, const void*, size_t, const void*,
+                   const void*);
+    int  (*get)   (const ConcurrentMap*, const void*, size_t, const void*);
+    void (*free)  (const ConcurrentMap*, void (*)(void*));
+};
+
+/* Keys are copied into the map. The capacity is rounded up to a power of
+ * two; when it fills up, a table of twice the size is chained behind it. A
+ * zero capacity selects the default above. */
+const ConcurrentMap *new_ConcurrentMap(size_t capacity);
+
+#endif//CONCURRENT_MAP_H
@@ -0,0 +1,34 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stddef.h> // size_t
+#include "arena.h"
+
+#define INTERNER_CAPACITY 256
+
+/* An interned identifier. There is exactly one Symbol per distinct name in
+ * an Interner, so names can be compared by pointer, and ids are dense so
+ * they can index per-symbol arrays. */
+typedef struct symbol Symbol;
+
+struct symbol {
+    const char *name;   // NUL-terminated
+    size_t     len;
+    int        id;      // Order of first appearance, starting at 0
+};
+
+typedef struct interner Interner;
+
+struct interner {
+    void *data;
+    const Symbol *(*intern)(const Interner *this, const char *str, size_t len);
+    const Symbol *(*get)   (const Interner *this, int id);
+    int           (*size)  (const Interner *this);
+    void          (*free)  (const Interner *this);
+};
+
+/* Symbols and their names are allocated in 'arena', which must outlive the
+ * interner's users. */
+const Interner *new_Interner(const Arena *arena);
+
+#endif//INTERNER_H
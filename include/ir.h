@@ -0,0 +1,101 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+#include "ast.h"
+#include "typechecker.h"
+#include "vector.h"
+#include "writer.h"
+
+/* SSA intermediate representation of one file, between the checked AST and
+ * the backends.
+ *
+ * A value is an index into parallel arrays holding its opcode, type and
+ * operands, so passes scan flat memory instead of chasing AST pointers, and
+ * each value is defined exactly once, by its own instruction. Values are
+ * stored in program order, grouped into basic blocks; T has no control flow
+ * yet, so a file is a single block.
+ *
+ * The file's variables are globals in memory rather than SSA values, since
+ * the files of a program share them: every assignment is a store, and every
+ * read a load. Turning loads into the values stored is left to the
+ * optimizer. Since an assignment's value is its target's new value, a chain
+ * a = b = c is built as c's load, b's store, a load of b and a's store, so
+ * every load is used once, by the instruction right after it. */
+
+typedef uint32_t IRValue;
+
+#define IR_NONE     UINT32_MAX
+#define IR_CAPACITY 64
+
+typedef enum ir_op {
+    IR_INT,         // arg is the value, as an int32_t
+    IR_DOUBLE,      // arg indexes constants
+    IR_LOAD,        // arg is the global read
+    IR_STORE,       // arg is the global written, operand the value stored
+    IR_NOP,         // Deleted by a pass; see compact_IR()
+    IR_OP_COUNT
+} IROp;
+
+typedef struct ir_global {
+    char *name;
+    Type type;
+} IRGlobal;
+
+// The values [first, end) in order
+typedef struct ir_block {
+    IRValue first;
+    IRValue end;
+} IRBlock;
+
+VECTOR_DEFINE(IRGlobals, IRGlobal)
+VECTOR_DEFINE(IRBlocks, IRBlock)
+VECTOR_DEFINE(IRConstants, double)
+
+typedef struct ir {
+    uint32_t    size;
+    uint32_t    capacity;
+    uint8_t     *ops;           // IROp
+    uint8_t     *types;         // Type; a store has the stored value's
+    uint32_t    *args;
+    IRValue     *operands;      // IR_NONE if the op takes none
+    IRBlocks    blocks;
+    IRConstants constants;
+    IRGlobals   globals;        // In order of first assignment
+    /* Use-def index, built by index_IR(): the users of value v are
+     * uses[use_offsets[v]] up to uses[use_offsets[v + 1]], in order. */
+    uint32_t    *use_offsets;
+    IRValue     *uses;
+} IR;
+
+IR *new_IR(void);
+void free_IR(IR *ir);
+
+/* Build the IR of a file that passed 'checker' into an empty 'ir', and index
+ * its uses. The IR keeps no pointers into the AST. Returns nonzero if out of
+ * memory. */
+int build_IR(IR *ir, const ASTNode *root, const TypeChecker *checker);
+
+/* (Re)build the use-def index, which passes that change operands must do
+ * before anything reads it again. Returns nonzero if out of memory. */
+int index_IR(IR *ir);
+
+/* Drop the IR_NOP values, renumbering the others and their operands, and
+ * reindex. Returns nonzero if out of memory. */
+int compact_IR(IR *ir);
+
+static inline uint32_t use_count_IR(const IR *ir, IRValue value) {
+    return ir->use_offsets[value + 1] - ir->use_offsets[value];
+}
+
+/* Whether 'value' is used once, by the value right after it, so a backend
+ * can fold it into that instruction instead of keeping it anywhere. */
+static inline int is_folded_IR(const IR *ir, IRValue value) {
+    return use_count_IR(ir, value) == 1 &&
+           ir->uses[ir->use_offsets[value]] == value + 1;
+}
+
+// Text form of the IR, for --emit=ir
+void dump_IR(const IR *ir, const char *filename, Writer *out);
+
+#endif//IR_H
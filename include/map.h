@@ -2,6 +2,7 @@
 #define MAP_H
 
 #include <stddef.h> // size_t
+#include <stdint.h>
 
 typedef struct map Map;
 
@@ -16,6 +17,12 @@ struct map {
     void (*free)    (const Map*, void (*)(void*));
 };
 
+/* Byte-string keys are copied into the map. The capacity is rounded up to a
+ * power of two and doubles whenever the load factor would be exceeded; zero
+ * arguments select the defaults above. */
 const Map *new_Map(size_t, double);
 
+// The maps' key hash; never 0, so 0 can mark an empty slot
+uint64_t hash_Map(const void *key, size_t len);
+
 #endif//MAP_H
@@ -0,0 +1,24 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ir.h"
+
+/* Optimization passes over a file's IR, run between building it and handing
+ * it to a backend. At level 1 (-O):
+ *
+ *   propagation    a load of a global that the block has already stored or
+ *                  loaded is replaced by that value, so constants flow
+ *                  through chains like a = b = 5
+ *   dead stores    a store overwritten later in its block, with no load of
+ *                  the global in between, is deleted
+ *
+ * after which values that are no longer used are deleted too. A file's last
+ * store to each global always stays, since later files read it and the
+ * program prints it. Level 0 leaves the IR as it is. */
+
+#define OPTIMIZER_MAX_LEVEL 1
+
+// Returns nonzero if out of memory, which may leave 'ir' half optimized
+int optimize_IR(IR *ir, int level);
+
+#endif//OPTIMIZER_H
@@ -0,0 +1,15 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Run task(ctx, i) for every i in [0, count) on up to 'threads' threads.
+ * finish(ctx, i) is called on the calling thread in index order, as soon as
+ * task i has completed, so results can be emitted deterministically while
+ * later tasks are still running. finish may be NULL. If no threads can be
+ * started, everything runs on the calling thread. */
+void parallel_for(int threads,
+                  int count,
+                  void (*task)(void *ctx, int i),
+                  void (*finish)(void *ctx, int i),
+                  void *ctx);
+
+#endif//POOL_H
@@ -1,6 +1,10 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
+#include <limits.h> // UINT_MAX
+#include <stdlib.h> // malloc(), free()
+#include <string.h> // memcpy()
+
 #define QUEUE_CAPACITY 16
 
 typedef struct queue Queue;
@@ -8,7 +12,11 @@ typedef struct queue Queue;
 struct queue {
     void *data;
     int  (*push) (const Queue *this, const void *val);
+    // Push 'count' values in order
+    int  (*push_n)(const Queue *this, const void *const *vals, int count);
     int  (*pop)  (const Queue *this, const void *val_ptr);
+    // Pop exactly 'count' values into vals, or nothing if there are fewer
+    int  (*pop_n)(const Queue *this, const void **vals, int count);
     int  (*front)(const Queue *this, const void *val_ptr);
     int  (*size) (const Queue *this);
     void (*free) (const Queue *this, void (*free_val)(const void*));
@@ -16,4 +24,135 @@ struct queue {
 
 const Queue *new_Queue(int capacity);
 
+/* QUEUE_DEFINE(Name, T) defines Name, a FIFO ring buffer storing values of
+ * type T directly, with static inline operations named <op>_Name. The
+ * capacity is a power of two so indices wrap with a mask, and it doubles when
+ * the queue is full. Operations returning int return nonzero on failure,
+ * including popping or peeking at an empty queue. The batch operations copy
+ * their values in at most two memcpy() runs, one on each side of the wrap.
+ *
+ *   int  init_Name  (Name *queue, int capacity)
+ *   int  push_Name  (Name *queue, T val)
+ *   int  push_n_Name(Name *queue, const T *vals, int count)
+ *   int  pop_Name   (Name *queue, T *val_ptr)
+ *   int  pop_n_Name (Name *queue, T *vals, int count)  exactly count, or none
+ *   int  front_Name (const Name *queue, T *val_ptr)
+ *   int  size_Name  (const Name *queue)
+ *   void free_Name  (Name *queue)
+ */
+#define QUEUE_DEFINE(Name, T) \
+typedef struct { \
+    T        *values; \
+    unsigned mask;  /* Capacity - 1 */ \
+    unsigned front; \
+    unsigned size; \
+} Name; \
+\
+static inline int init_##Name(Name *queue, int capacity) { \
+    unsigned cap = 1; \
+    while (cap < (unsigned)(capacity > 0 ? capacity : QUEUE_CAPACITY)) { \
+        cap *= 2; \
+    } \
+    queue->mask = cap - 1; \
+    queue->front = queue->size = 0; \
+    queue->values = malloc(cap * sizeof(T)); \
+    return queue->values == NULL; \
+} \
+\
+/* Double the capacity until 'needed' values fit, unwrapping the ring so \
+ * front is at 0 */ \
+static inline int reserve_##Name(Name *queue, unsigned needed) { \
+    unsigned old_cap = queue->mask + 1, cap = old_cap; \
+    if (needed <= cap) { \
+        return 0; \
+    } \
+    while (cap < needed) { \
+        if (cap > UINT_MAX / 2) { \
+            return 1; \
+        } \
+        cap *= 2; \
+    } \
+    T *values = malloc(cap * sizeof(T)); \
+    if (values == NULL) { \
+        return 1; \
+    } \
+    unsigned head = old_cap - queue->front; \
+    if (head > queue->size) { \
+        head = queue->size; \
+    } \
+    memcpy(values, queue->values + queue->front, head * sizeof(T)); \
+    memcpy(values + head, queue->values, (queue->size - head) * sizeof(T)); \
+    free(queue->values); \
+    queue->values = values; \
+    queue->mask = cap - 1; \
+    queue->front = 0; \
+    return 0; \
+} \
+\
+static inline int push_##Name(Name *queue, T val) { \
+    if (queue->size > queue->mask && \
+        reserve_##Name(queue, queue->size + 1)) { \
+        return 1; \
+    } \
+    queue->values[(queue->front + queue->size++) & queue->mask] = val; \
+    return 0; \
+} \
+\
+static inline int push_n_##Name(Name *queue, const T *vals, int count) { \
+    if (count < 0 || (unsigned)count > UINT_MAX - queue->size || \
+        reserve_##Name(queue, queue->size + count)) { \
+        return 1; \
+    } \
+    unsigned back = (queue->front + queue->size) & queue->mask; \
+    unsigned head = queue->mask + 1 - back; \
+    if (head > (unsigned)count) { \
+        head = count; \
+    } \
+    memcpy(queue->values + back, vals, head * sizeof(T)); \
+    memcpy(queue->values, vals + head, (count - head) * sizeof(T)); \
+    queue->size += count; \
+    return 0; \
+} \
+\
+static inline int pop_##Name(Name *queue, T *val_ptr) { \
+    if (queue->size == 0 || val_ptr == NULL) { \
+        return 1; \
+    } \
+    *val_ptr = queue->values[queue->front]; \
+    queue->front = (queue->front + 1) & queue->mask; \
+    queue->size--; \
+    return 0; \
+} \
+\
+static inline int pop_n_##Name(Name *queue, T *vals, int count) { \
+    if (vals == NULL || count < 0 || (unsigned)count > queue->size) { \
+        return 1; \
+    } \
+    unsigned head = queue->mask + 1 - queue->front; \
+    if (head > (unsigned)count) { \
+        head = count; \
+    } \
+    memcpy(vals, queue->values + queue->front, head * sizeof(T)); \
+    memcpy(vals + head, queue->values, (count - head) * sizeof(T)); \
+    queue->front = (queue->front + count) & queue->mask; \
+    queue->size -= count; \
+    return 0; \
+} \
+\
+static inline int front_##Name(const Name *queue, T *val_ptr) { \
+    if (queue->size == 0 || val_ptr == NULL) { \
+        return 1; \
+    } \
+    *val_ptr = queue->values[queue->front]; \
+    return 0; \
+} \
+\
+static inline int size_##Name(const Name *queue) { \
+    return queue->size; \
+} \
+\
+static inline void free_##Name(Name *queue) { \
+    free(queue->values); \
+}
+
 #endif//QUEUE_H
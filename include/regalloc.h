@@ -0,0 +1,39 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdint.h>
+#include "ir.h"
+
+/* Linear-scan register allocation over a file's IR.
+ *
+ * A value is live from its definition to the last value that reads it.
+ * Since the IR is in SSA form and stored in program order, these intervals
+ * come sorted by start, and one pass over them assigns registers. When
+ * more values are live than there are registers, the one whose interval
+ * ends last is spilled to a slot in memory for the whole of its life. Slots
+ * are not reused.
+ *
+ * The backend says where each interval ends rather than the allocator
+ * reading it off the IR's uses, since it may read a value in place of
+ * others, like a variable's value in place of later loads of it. Values it
+ * needs in no location, like constants it encodes as immediates, get
+ * none. */
+
+#define REGALLOC_NONE UINT32_MAX
+
+typedef struct register_allocation {
+    /* Per value: a register below 'registers', registers + a spill slot,
+     * or REGALLOC_NONE. */
+    uint32_t *locations;
+    uint32_t registers;
+    uint32_t spill_slots;
+} RegisterAllocation;
+
+/* Allocate 'registers' registers to the values of 'ir'. ends[v] is the
+ * last value that reads v, or IR_NONE if v needs no location. Returns NULL
+ * if out of memory. */
+RegisterAllocation *new_RegisterAllocation(const IR *ir, uint32_t registers,
+                                           const IRValue *ends);
+void free_RegisterAllocation(RegisterAllocation *allocation);
+
+#endif//REGALLOC_H
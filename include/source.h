@@ -0,0 +1,22 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h> // size_t
+
+/* The contents of an input file, followed by the two NUL bytes flex needs to
+ * scan a buffer in place. Regular files are memory-mapped; anything else is
+ * read into a heap buffer. Either way, the scanner works directly on data
+ * and slices of it stay valid until the source is freed. */
+typedef struct source Source;
+
+struct source {
+    char   *data;
+    size_t size;        // Size of the contents, excluding the padding
+    size_t capacity;    // Size of the mapping or allocation behind data
+    int    mapped;
+};
+
+Source *new_Source(const char *filename);
+void free_Source(Source *src);
+
+#endif//SOURCE_H
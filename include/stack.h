@@ -1,6 +1,8 @@
 #ifndef STACK_H
 #define STACK_H
 
+#include <stdlib.h> // malloc(), realloc(), free()
+
 #define STACK_CAPACITY 16
 
 typedef struct stack Stack;
@@ -16,4 +18,67 @@ struct stack {
 
 const Stack *new_Stack(int capacity);
 
+/* STACK_DEFINE(Name, T) defines Name, a stack storing values of type T
+ * directly, with static inline operations named <op>_Name. Capacity doubles
+ * when the stack is full. Operations returning int return nonzero on
+ * failure, including popping or peeking at an empty stack.
+ *
+ *   int  init_Name(Name *stack, int capacity)
+ *   int  push_Name(Name *stack, T val)
+ *   int  pop_Name (Name *stack, T *val_ptr)
+ *   int  top_Name (const Name *stack, T *val_ptr)
+ *   int  size_Name(const Name *stack)
+ *   void free_Name(Name *stack)
+ */
+#define STACK_DEFINE(Name, T) \
+typedef struct { \
+    T   *values; \
+    int size; \
+    int capacity; \
+} Name; \
+\
+static inline int init_##Name(Name *stack, int capacity) { \
+    stack->size = 0; \
+    stack->capacity = capacity > 0 ? capacity : STACK_CAPACITY; \
+    stack->values = malloc(stack->capacity * sizeof(T)); \
+    return stack->values == NULL; \
+} \
+\
+static inline int push_##Name(Name *stack, T val) { \
+    if (stack->size == stack->capacity) { \
+        T *values = realloc(stack->values, 2 * stack->capacity * sizeof(T)); \
+        if (values == NULL) { \
+            return 1; \
+        } \
+        stack->values = values; \
+        stack->capacity *= 2; \
+    } \
+    stack->values[stack->size++] = val; \
+    return 0; \
+} \
+\
+static inline int pop_##Name(Name *stack, T *val_ptr) { \
+    if (stack->size <= 0 || val_ptr == NULL) { \
+        return 1; \
+    } \
+    *val_ptr = stack->values[--stack->size]; \
+    return 0; \
+} \
+\
+static inline int top_##Name(const Name *stack, T *val_ptr) { \
+    if (stack->size <= 0 || val_ptr == NULL) { \
+        return 1; \
+    } \
+    *val_ptr = stack->values[stack->size - 1]; \
+    return 0; \
+} \
+\
+static inline int size_##Name(const Name *stack) { \
+    return stack->size; \
+} \
+\
+static inline void free_##Name(Name *stack) { \
+    free(stack->values); \
+}
+
 #endif//STACK_H
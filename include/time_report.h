@@ -0,0 +1,56 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stddef.h> // size_t
+#include <time.h>   // struct timespec
+#include "writer.h"
+
+/* Phase timings and sizes for --time-report. Each file's report is only
+ * ever touched by the thread compiling it, so reports need no locking.
+ *
+ * Time is charged in laps: lap_TimeReport() adds the wall and CPU time
+ * since the previous lap to a phase. CPU time is that of the calling
+ * thread, plus that of any child processes waited for, such as the C
+ * compiler. Every function accepts a NULL report and then does nothing, so
+ * callers need not check whether reporting is on. */
+
+typedef enum phase {
+    PHASE_NONE = -1,    // Time that is not charged to any phase
+    PHASE_PARSE,        // Scanning and parsing, which run interleaved
+    PHASE_CHECK,
+    PHASE_IR,           // Building and optimizing the IR
+    PHASE_EMIT,         // Writing JSON or a binary AST, or the backend
+    PHASE_TEARDOWN,
+    PHASE_CC,           // Building the executable with the C compiler
+    PHASE_RUN,          // Running the program in the VM
+    PHASE_COUNT
+} Phase;
+
+// Seconds
+typedef struct phase_time {
+    double wall;
+    double cpu;
+} PhaseTime;
+
+typedef struct time_report {
+    PhaseTime       phases[PHASE_COUNT];
+    size_t          tokens;
+    size_t          nodes;
+    size_t          arena_bytes;    // Allocated for the AST and identifiers
+    struct timespec start;          // When the report was started
+    struct timespec lap_wall;       // When the current lap began
+    double          lap_cpu;
+} TimeReport;
+
+// Clear the report and start the first lap
+void start_TimeReport(TimeReport *report);
+void lap_TimeReport(TimeReport *report, Phase phase);
+
+/* Write the reports of the program's files, whose names are filenames, and
+ * then their total, to which 'program' adds its own phases, the time since
+ * it was started and the peak resident set size. */
+void write_TimeReport(const TimeReport *files, char *const *filenames,
+                      int count, const TimeReport *program, Writer *out,
+                      int json);
+
+#endif//TIME_REPORT_H
@@ -1,6 +1,121 @@
 #ifndef TYPECHECKER_H
 #define TYPECHECKER_H
 
+#include <stdio.h>
+#include "ast.h"
+#include "interner.h"
+#include "concurrent_map.h"
+#include "vector.h"
+#include "stack.h"
 
+/* Types of expressions and variables. TYPE_ERROR is given to expressions
+ * that already failed to check, so one mistake is reported only once. */
+typedef enum type {
+    TYPE_UNKNOWN,       // Variable not bound in any open scope
+    TYPE_ERROR,
+    TYPE_INT,
+    TYPE_DOUBLE
+} Type;
+
+const char *name_Type(Type type);
+
+typedef struct type_declaration {
+    int           id;       // Symbol id
+    const ASTNode *target;  // Valid as long as the AST is
+} TypeDeclaration;
+
+VECTOR_DEFINE(TypeDeclarations, TypeDeclaration)
+STACK_DEFINE(TypeScopeStack, int)
+
+/* A variable declared in a file's global scope, as shared between the
+ * checkers of all the files of a program. */
+typedef struct global_symbol GlobalSymbol;
+typedef struct global_name   GlobalName;
+
+struct global_symbol {
+    Type             type;
+    int              file;      // Index of the declaring file in input order
+    const char       *filename;
+    int              line;
+    int              column;
+    const GlobalName *name;
+};
+
+/* The shared entry for one global name. 'first' is the declaration from
+ * the earliest file, in input order, that has been checked so far; checkers
+ * lower it with a compare-and-swap as they publish. */
+struct global_name {
+    const GlobalSymbol *first;
+    char               name[];  // NUL-terminated
+};
+
+VECTOR_DEFINE(GlobalSymbols, GlobalSymbol)
+
+/* Infers and checks the types of one file's AST in a single pass.
+ *
+ * A variable is declared in the innermost open scope by its first
+ * assignment, and takes the type of the assigned value; later assignments,
+ * from any scope it is visible in, must agree with it. Rather than one hash
+ * table per scope, the checker keeps the type of every visible variable in an
+ * array indexed by symbol id, so a lookup is a single load. Declarations are
+ * also logged in order, and closing a scope forgets the ones made since it
+ * was opened, which keeps the whole pass linear in the size of the tree.
+ *
+ * The files of a program share one global namespace, so a global variable
+ * must have the same type in every file that assigns it. Each file is
+ * checked on its own, possibly on a worker thread, and then publishes its
+ * globals to the shared 'globals' map. Conflicts are reported afterwards by
+ * check_GlobalSymbols(), against the earliest file that declared the name,
+ * so the same files give the same errors however the checks were scheduled.
+ *
+ * Globals are only shared to find such conflicts. Uses are still resolved
+ * as if each file were alone, so using a name that only an earlier file
+ * assigns is an error: every file must assign its globals before using
+ * them. */
+typedef struct type_checker TypeChecker;
+
+struct type_checker {
+    const Interner      *interner;
+    const char          *filename;
+    FILE                *diagnostics;
+    const ConcurrentMap *globals;       // Name -> GlobalName, or NULL
+    int                 file;           // Index of the file in input order
+    GlobalSymbols       *published;     // The file's globals, once checked
+    Type                *types;         // Symbol id -> visible type
+    int                 types_size;
+    TypeDeclarations    declarations;   // In declaration order
+    TypeScopeStack      scopes;         // Declarations before each scope
+    int                 errors;
+};
+
+/* Type errors are reported to 'diagnostics' as filename:line:column. The
+ * checker starts with the file's global scope open. If globals is NULL, the
+ * file is checked as a program of its own. Otherwise the map's values must
+ * be GlobalNames, which belong to the map and are released by its owner
+ * with the map's free(), and the file's globals are appended to published,
+ * an empty vector that must outlive the checks of all the files and must
+ * not be modified afterwards, since the map points into it. */
+TypeChecker *new_TypeChecker(const Interner *interner, const char *filename,
+                             FILE *diagnostics, const ConcurrentMap *globals,
+                             int file, GlobalSymbols *published);
+void free_TypeChecker(TypeChecker *checker);
+
+/* Check the tree under root, a Program node. Returns the number of type
+ * errors found, or -1 if the checker ran out of memory. With a globals map
+ * it must only be called once per checker. */
+int check_TypeChecker(TypeChecker *checker, const ASTNode *root);
+
+/* Report the globals a file published whose type differs from that of the
+ * same name in the earliest file that declared it. Every file before this
+ * one must have been checked, so that the earliest declaration is known.
+ * Returns the number of conflicts. */
+int check_GlobalSymbols(const GlobalSymbols *globals, FILE *diagnostics);
+
+// Scopes for nested blocks; returns nonzero if out of memory
+int open_scope_TypeChecker(TypeChecker *checker);
+void close_scope_TypeChecker(TypeChecker *checker);
+
+// Type of the variable visible as 'name', or TYPE_UNKNOWN if there is none
+Type lookup_TypeChecker(const TypeChecker *checker, const Symbol *name);
 
 #endif//TYPECHECKER_H
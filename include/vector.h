@@ -1,23 +1,103 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include <stdlib.h> // malloc(), realloc(), free()
+
 #define VECTOR_CAPACITY 16
+#define VECTOR_GROWTH_FACTOR 2  // Capacity multiplier when the vector is full
 
 typedef struct vector Vector;
 
 struct vector {
     void   *data;
     int    (*append)(const Vector *this, const void *val);
+    int    (*append_range)(const Vector *this, const void *const *vals,
+                           int count);
     int    (*get)   (const Vector *this, int index, const void *val_ptr);
     int    (*put)   (const Vector *this, int index, const void *val,
                      const void *prev_ptr);
     int    (*remove)(const Vector *this, int index, const void *prev_ptr);
     int    (*size)  (const Vector *this);
+    int    (*reserve)(const Vector *this, int capacity);
+    int    (*shrink_to_fit)(const Vector *this);
+    // Copy of the values, to be freed by the caller
     void **(*array) (const Vector *this, int *size);
+    /* The values themselves, without copying. Only valid until the vector is
+     * next modified. */
+    const void *const *(*view)(const Vector *this, int *size);
     void   (*free)  (const Vector *this, void(*free_val)(const void*));
 
 };
 
 const Vector *new_Vector(int capacity);
 
+/* VECTOR_DEFINE(Name, T) defines Name, a vector storing values of type T
+ * directly, and static inline operations on it named <op>_Name. Unlike
+ * Vector there is no dispatch through function pointers and no boxing, so
+ * these suit hot paths. Operations returning int return nonzero on failure.
+ *
+ *   int  init_Name   (Name *vec, int capacity)
+ *   int  reserve_Name(Name *vec, int capacity)
+ *   int  append_Name (Name *vec, T val)
+ *   int  get_Name    (const Name *vec, int index, T *val_ptr)
+ *   T   *at_Name     (const Name *vec, int index)  // Not bounds-checked
+ *   int  size_Name   (const Name *vec)
+ *   void free_Name   (Name *vec)
+ */
+#define VECTOR_DEFINE(Name, T) \
+typedef struct { \
+    T   *values; \
+    int size; \
+    int capacity; \
+} Name; \
+\
+static inline int init_##Name(Name *vec, int capacity) { \
+    vec->size = 0; \
+    vec->capacity = capacity > 0 ? capacity : VECTOR_CAPACITY; \
+    vec->values = malloc(vec->capacity * sizeof(T)); \
+    return vec->values == NULL; \
+} \
+\
+static inline int reserve_##Name(Name *vec, int capacity) { \
+    if (capacity <= vec->capacity) { \
+        return 0; \
+    } \
+    T *values = realloc(vec->values, capacity * sizeof(T)); \
+    if (values == NULL) { \
+        return 1; \
+    } \
+    vec->values = values; \
+    vec->capacity = capacity; \
+    return 0; \
+} \
+\
+static inline int append_##Name(Name *vec, T val) { \
+    if (vec->size == vec->capacity && \
+        reserve_##Name(vec, vec->capacity * VECTOR_GROWTH_FACTOR)) { \
+        return 1; \
+    } \
+    vec->values[vec->size++] = val; \
+    return 0; \
+} \
+\
+static inline int get_##Name(const Name *vec, int index, T *val_ptr) { \
+    if (index < 0 || index >= vec->size || val_ptr == NULL) { \
+        return 1; \
+    } \
+    *val_ptr = vec->values[index]; \
+    return 0; \
+} \
+\
+static inline T *at_##Name(const Name *vec, int index) { \
+    return &vec->values[index]; \
+} \
+\
+static inline int size_##Name(const Name *vec) { \
+    return vec->size; \
+} \
+\
+static inline void free_##Name(Name *vec) { \
+    free(vec->values); \
+}
+
 #endif//VECTOR_H
@@ -0,0 +1,19 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdio.h>
+#include "bytecode.h"
+
+/* A register's contents. Bytecode registers are statically typed, so the
+ * value carries no tag; the instruction using it knows which member. */
+typedef union value {
+    int    i;
+    double d;
+} Value;
+
+/* Run a linked and sealed program with zeroed registers, then print every
+ * named register to 'out' as "name = value", like the generated C does.
+ * Returns nonzero if out of memory or the output could not be written. */
+int run_VM(const Bytecode *program, FILE *out);
+
+#endif//VM_H
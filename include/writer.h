@@ -0,0 +1,71 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <string.h> // memcpy(), strlen()
+
+#define WRITER_BUFFER_SIZE (1024 * 1024)
+#define WRITER_MAX_INDENT  256     // Deeper indentation is written in pieces
+
+/* Buffered text output for the AST dumps. Output collects in a large buffer
+ * and reaches the FILE only in whole-buffer fwrite() calls, so emitting a
+ * token costs a memcpy() rather than a stdio call.
+ *
+ * A writer is either pretty, indenting nested levels by indent_width spaces,
+ * or compact (indent_width 0), where writer_indent() and writer_key() leave
+ * out all optional whitespace. */
+typedef struct writer Writer;
+
+struct writer {
+    FILE   *out;
+    char   *buf;
+    size_t size;
+    int    indent_width;
+    int    error;                   // Set once any fwrite() fails
+    char   indentation[1 + WRITER_MAX_INDENT];  // "\n" and spaces
+};
+
+Writer *new_Writer(FILE *out, int indent_width);
+// Write out the buffer; returns nonzero if any output was lost so far
+int flush_Writer(Writer *writer);
+// Flush and release the writer; returns like flush_Writer()
+int free_Writer(Writer *writer);
+
+// Slow path of writer_bytes(), for when the buffer is full
+void writer_spill(Writer *writer, const char *bytes, size_t len);
+
+static inline void writer_bytes(Writer *writer, const char *bytes,
+                                size_t len) {
+    if (len > WRITER_BUFFER_SIZE - writer->size) {
+        writer_spill(writer, bytes, len);
+        return;
+    }
+    memcpy(writer->buf + writer->size, bytes, len);
+    writer->size += len;
+}
+
+static inline void writer_char(Writer *writer, char c) {
+    if (writer->size == WRITER_BUFFER_SIZE) {
+        flush_Writer(writer);
+    }
+    writer->buf[writer->size++] = c;
+}
+
+static inline void writer_str(Writer *writer, const char *str) {
+    writer_bytes(writer, str, strlen(str));
+}
+
+// Decimal, without going through printf()
+void writer_int(Writer *writer, long val);
+
+// Shortest of %.15g and %.17g that reads back as the same value
+void writer_double(Writer *writer, double val);
+
+// Start a new line at nesting depth 'level'. Nothing in compact mode.
+void writer_indent(Writer *writer, int level);
+
+/* A JSON object key, its colon and, unless compact, a space:
+ * "key": value */
+void writer_key(Writer *writer, const char *key);
+
+#endif//WRITER_H
@@ -0,0 +1,112 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h> // memcpy(), strlen()
+
+typedef struct chunk Chunk;
+
+struct chunk {
+    Chunk  *prev;
+    size_t capacity;
+    size_t size;
+    char   bytes[];
+};
+
+struct arena_data {
+    Chunk  *head;
+    size_t chunk_size;
+    size_t used;
+};
+
+static Chunk *new_Chunk(Chunk *prev, size_t capacity) {
+    Chunk *chunk = malloc(sizeof(*chunk) + capacity);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->prev = prev;
+    chunk->capacity = capacity;
+    chunk->size = 0;
+    return chunk;
+}
+
+static void *arena_bump(const Arena *this, size_t size, size_t align) {
+    struct arena_data *data = this->data;
+    Chunk *chunk = data->head;
+    size_t offset = (chunk->size + align - 1) & ~(align - 1);
+    if (offset + size > chunk->capacity) {
+        /* Start a new chunk, doubling the chunk size each time so that a
+         * translation unit only ever needs a handful of chunks. */
+        size_t cap = data->chunk_size;
+        if (cap < ARENA_MAX_CHUNK_SIZE) {
+            data->chunk_size *= 2;
+        }
+        if (cap < size) {
+            cap = size;
+        }
+        chunk = new_Chunk(data->head, cap);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        data->head = chunk;
+        offset = 0;
+    }
+    chunk->size = offset + size;
+    data->used += size;
+    return chunk->bytes + offset;
+}
+
+static void *arena_alloc(const Arena *this, size_t size) {
+    return arena_bump(this, size, ARENA_ALIGNMENT);
+}
+
+static char *arena_strdup(const Arena *this, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_bump(this, len, 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, str, len);
+    return copy;
+}
+
+static size_t arena_used(const Arena *this) {
+    struct arena_data *data = this->data;
+    return data->used;
+}
+
+static void arena_free(const Arena *this) {
+    struct arena_data *data = this->data;
+    Chunk *chunk = data->head;
+    while (chunk != NULL) {
+        Chunk *prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+    free(data);
+    free((void*)this);
+}
+
+const Arena *new_Arena(size_t chunk_size) {
+    struct arena_data *data = malloc(sizeof(*data));
+    if (data == NULL) {
+        return NULL;
+    }
+    data->chunk_size = chunk_size > 0 ? chunk_size : ARENA_CHUNK_SIZE;
+    data->used = 0;
+    data->head = new_Chunk(NULL, data->chunk_size);
+    if (data->head == NULL) {
+        free(data);
+        return NULL;
+    }
+    Arena *arena = malloc(sizeof(*arena));
+    if (arena == NULL) {
+        free(data->head);
+        free(data);
+        return NULL;
+    }
+    arena->data   = data;
+    arena->alloc  = arena_alloc;
+    arena->strdup = arena_strdup;
+    arena->used   = arena_used;
+    arena->free   = arena_free;
+    return arena;
+}
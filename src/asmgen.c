@@ -0,0 +1,367 @@
+#include "asmgen.h"
+#include <stdlib.h>
+#include <string.h> // memcpy()
+#include "regalloc.h"
+
+/* The registers values are allocated, all caller-saved: the run functions
+ * call nothing, so they need not save any. r11 is kept back as scratch for
+ * moving spilled values, since x86 has no memory-to-memory move. */
+#define ASMGEN_REGISTERS 8
+
+static const char *const registers64[ASMGEN_REGISTERS] = {
+    "%rax", "%rcx", "%rdx", "%rsi", "%rdi", "%r8", "%r9", "%r10"
+};
+static const char *const registers32[ASMGEN_REGISTERS] = {
+    "%eax", "%ecx", "%edx", "%esi", "%edi", "%r8d", "%r9d", "%r10d"
+};
+
+/* t_print_double() prints like the C backend's: %.15g, or %.17g when that
+ * doesn't read back as the same double. */
+static const char prelude[] =
+    "\t.section .rodata\n"
+    ".Lint_format:\n"
+    "\t.string \"%s = %d\\n\"\n"
+    ".Lstr_format:\n"
+    "\t.string \"%s = %s\\n\"\n"
+    ".Lg15_format:\n"
+    "\t.string \"%.15g\"\n"
+    ".Lg17_format:\n"
+    "\t.string \"%.17g\"\n"
+    "\t.text\n"
+    "t_print_int:\n"
+    "\tmovl\t%esi, %edx\n"
+    "\tmovq\t%rdi, %rsi\n"
+    "\tleaq\t.Lint_format(%rip), %rdi\n"
+    "\txorl\t%eax, %eax\n"
+    "\tjmp\tprintf@PLT\n"
+    "t_print_double:\n"
+    "\tpushq\t%rbx\n"
+    "\tsubq\t$48, %rsp\n"
+    "\tmovq\t%rdi, %rbx\n"
+    "\tmovsd\t%xmm0, 32(%rsp)\n"
+    "\tmovq\t%rsp, %rdi\n"
+    "\tmovl\t$32, %esi\n"
+    "\tleaq\t.Lg15_format(%rip), %rdx\n"
+    "\tmovl\t$1, %eax\n"
+    "\tcall\tsnprintf@PLT\n"
+    "\tmovq\t%rsp, %rdi\n"
+    "\txorl\t%esi, %esi\n"
+    "\tcall\tstrtod@PLT\n"
+    "\tucomisd\t32(%rsp), %xmm0\n"
+    "\tjp\t1f\n"
+    "\tje\t2f\n"
+    "1:\tmovq\t%rsp, %rdi\n"
+    "\tmovl\t$32, %esi\n"
+    "\tleaq\t.Lg17_format(%rip), %rdx\n"
+    "\tmovsd\t32(%rsp), %xmm0\n"
+    "\tmovl\t$1, %eax\n"
+    "\tcall\tsnprintf@PLT\n"
+    "2:\tleaq\t.Lstr_format(%rip), %rdi\n"
+    "\tmovq\t%rbx, %rsi\n"
+    "\tmovq\t%rsp, %rdx\n"
+    "\txorl\t%eax, %eax\n"
+    "\tcall\tprintf@PLT\n"
+    "\taddq\t$48, %rsp\n"
+    "\tpopq\t%rbx\n"
+    "\tret\n";
+
+void asmgen_prelude(Writer *out) {
+    writer_bytes(out, prelude, sizeof(prelude) - 1);
+}
+
+static void instruction(const char *mnemonic, Writer *out) {
+    writer_char(out, '\t');
+    writer_str(out, mnemonic);
+    writer_char(out, '\t');
+}
+
+// Ints are 32 bits and doubles 64, moved as raw bits
+static const char *move(Type type) {
+    return type == TYPE_INT ? "movl" : "movq";
+}
+
+static void global(const IR *ir, uint32_t index, Writer *out) {
+    writer_bytes(out, "v_", 2);
+    writer_str(out, ir->globals.values[index].name);
+    writer_str(out, "(%rip)");
+}
+
+static void scratch(Type type, Writer *out) {
+    writer_str(out, type == TYPE_INT ? "%r11d" : "%r11");
+}
+
+typedef struct unit_code {
+    const IR                 *ir;
+    const RegisterAllocation *allocation;
+    const IRValue            *homes;    // Per value: the value holding it
+    const IRValue            *ends;     // Per value: its last reader
+    const IRValue            *last;     // Per global: last store or load
+    int                      unit;
+    Writer                   *out;
+} UnitCode;
+
+static int is_spilled(const UnitCode *code, IRValue value) {
+    return code->allocation->locations[value] >= code->allocation->registers;
+}
+
+static void spill_slot(const UnitCode *code, IRValue value) {
+    writer_str(code->out, "t_spill_");
+    writer_int(code->out, code->unit);
+    writer_char(code->out, '+');
+    writer_int(code->out, 8 * (code->allocation->locations[value] -
+                               code->allocation->registers));
+    writer_str(code->out, "(%rip)");
+}
+
+// The register holding 'value', which is scratch if it is spilled
+static void location(const UnitCode *code, IRValue value) {
+    Type type = code->ir->types[value];
+    uint32_t reg = code->allocation->locations[value];
+    if (is_spilled(code, value)) {
+        scratch(type, code->out);
+    } else {
+        writer_str(code->out, type == TYPE_INT ? registers32[reg]
+                                               : registers64[reg]);
+    }
+}
+
+// Write a value just computed into scratch out to its spill slot
+static void spill(const UnitCode *code, IRValue value) {
+    if (!is_spilled(code, value)) {
+        return;
+    }
+    instruction(move(code->ir->types[value]), code->out);
+    scratch(code->ir->types[value], code->out);
+    writer_str(code->out, ", ");
+    spill_slot(code, value);
+    writer_char(code->out, '\n');
+}
+
+// Bring a spilled operand back into scratch
+static void reload(const UnitCode *code, IRValue value) {
+    if (!is_spilled(code, value)) {
+        return;
+    }
+    instruction(move(code->ir->types[value]), code->out);
+    spill_slot(code, value);
+    writer_str(code->out, ", ");
+    scratch(code->ir->types[value], code->out);
+    writer_char(code->out, '\n');
+}
+
+static void store(const UnitCode *code, IRValue value) {
+    const IR *ir = code->ir;
+    Writer *out = code->out;
+    IRValue operand = code->homes[ir->operands[value]];
+    if (ir->ops[operand] == IR_INT) {
+        instruction("movl", out);
+        writer_char(out, '$');
+        writer_int(out, (int32_t)ir->args[operand]);
+    } else {
+        reload(code, operand);
+        instruction(move(ir->types[value]), out);
+        location(code, operand);
+    }
+    writer_str(out, ", ");
+    global(ir, ir->args[value], out);
+    writer_char(out, '\n');
+}
+
+/* Whether a store is the last to its variable, and changes it. Storing a
+ * variable's own value back would not. */
+static int is_written_back(const UnitCode *code, IRValue store) {
+    const IR *ir = code->ir;
+    uint32_t global = ir->args[store];
+    IRValue value = code->homes[ir->operands[store]];
+    return code->last[global] == store &&
+           !(ir->ops[value] == IR_LOAD && ir->args[value] == global);
+}
+
+static void run_function(const UnitCode *code) {
+    const IR *ir = code->ir;
+    Writer *out = code->out;
+    writer_str(out, "t_run_");
+    writer_int(out, code->unit);
+    writer_str(out, ":\n");
+    for (IRValue v = 0; v < ir->size; v++) {
+        if (ir->ops[v] == IR_STORE) {
+            if (is_written_back(code, v)) {
+                store(code, v);
+            }
+            continue;
+        }
+        // Nothing else has side effects, so unread values are skipped
+        if (code->ends[v] == IR_NONE) {
+            continue;
+        }
+        if (ir->ops[v] == IR_DOUBLE) {
+            int64_t bits;
+            memcpy(&bits, &ir->constants.values[ir->args[v]], sizeof(bits));
+            instruction("movabsq", out);
+            writer_char(out, '$');
+            writer_int(out, bits);
+        } else {
+            instruction(move(ir->types[v]), out);
+            global(ir, ir->args[v], out);
+        }
+        writer_str(out, ", ");
+        location(code, v);
+        writer_char(out, '\n');
+        spill(code, v);
+    }
+    writer_str(out, "\tret\n");
+}
+
+static void print_function(const IR *ir, int unit, Writer *out) {
+    writer_str(out, "t_print_");
+    writer_int(out, unit);
+    writer_str(out, ":\n\tsubq\t$8, %rsp\n");
+    for (int i = 0; i < ir->globals.size; i++) {
+        const IRGlobal *g = &ir->globals.values[i];
+        instruction("cmpb", out);
+        writer_str(out, "$0, p_");
+        writer_str(out, g->name);
+        writer_str(out, "(%rip)\n");
+        instruction("jne", out);
+        writer_str(out, "1f\n");
+        instruction("movb", out);
+        writer_str(out, "$1, p_");
+        writer_str(out, g->name);
+        writer_str(out, "(%rip)\n");
+        instruction("leaq", out);
+        writer_str(out, ".Lname_");
+        writer_int(out, unit);
+        writer_char(out, '_');
+        writer_int(out, i);
+        writer_str(out, "(%rip), %rdi\n");
+        instruction(g->type == TYPE_INT ? "movl" : "movsd", out);
+        global(ir, i, out);
+        writer_str(out, g->type == TYPE_INT ? ", %esi\n" : ", %xmm0\n");
+        instruction("call", out);
+        writer_str(out, g->type == TYPE_INT ? "t_print_int\n"
+                                            : "t_print_double\n");
+        writer_str(out, "1:\n");
+    }
+    writer_str(out, "\taddq\t$8, %rsp\n\tret\n");
+    writer_str(out, "\t.section .rodata\n");
+    for (int i = 0; i < ir->globals.size; i++) {
+        writer_str(out, ".Lname_");
+        writer_int(out, unit);
+        writer_char(out, '_');
+        writer_int(out, i);
+        writer_str(out, ":\n\t.string \"");
+        writer_str(out, ir->globals.values[i].name);
+        writer_str(out, "\"\n");
+    }
+}
+
+/* Keep the unit's variables in registers. t_run_<unit> has no control flow
+ * and calls nothing, so nothing else can see a variable until it returns:
+ * a load of a variable the unit has already stored or loaded reads the
+ * value it has by then, and only the last store to each variable has to
+ * reach memory. Fills in the UnitCode arrays of the same names. */
+static void promote_variables(const IR *ir, IRValue *homes, IRValue *ends,
+                              IRValue *last) {
+    for (int i = 0; i < ir->globals.size; i++) {
+        last[i] = IR_NONE;
+    }
+    for (IRValue v = 0; v < ir->size; v++) {
+        uint32_t global = ir->args[v];
+        homes[v] = v;
+        ends[v] = IR_NONE;
+        if (ir->ops[v] == IR_STORE) {
+            last[global] = v;
+        } else if (ir->ops[v] == IR_LOAD) {
+            // Until the first store, last holds the first load, if any
+            if (last[global] == IR_NONE) {
+                last[global] = v;
+            } else if (ir->ops[last[global]] == IR_STORE) {
+                homes[v] = homes[ir->operands[last[global]]];
+            } else {
+                homes[v] = last[global];
+            }
+        }
+    }
+    /* The values written back live until their store, except those that
+     * is_written_back() skips; ints are immediates. */
+    for (int i = 0; i < ir->globals.size; i++) {
+        IRValue store = last[i];
+        if (store == IR_NONE || ir->ops[store] != IR_STORE) {
+            continue;
+        }
+        IRValue value = homes[ir->operands[store]];
+        if (ir->ops[value] == IR_LOAD && ir->args[value] == (uint32_t)i) {
+            continue;
+        }
+        if (ir->ops[value] != IR_INT &&
+            (ends[value] == IR_NONE || ends[value] < store)) {
+            ends[value] = store;
+        }
+    }
+}
+
+int asmgen_unit(const IR *ir, int unit, Writer *out) {
+    IRValue *homes = malloc((ir->size + 1) * sizeof(*homes));
+    IRValue *ends = malloc((ir->size + 1) * sizeof(*ends));
+    IRValue *last = malloc((ir->globals.size + 1) * sizeof(*last));
+    RegisterAllocation *allocation = NULL;
+    if (homes != NULL && ends != NULL && last != NULL) {
+        promote_variables(ir, homes, ends, last);
+        allocation = new_RegisterAllocation(ir, ASMGEN_REGISTERS, ends);
+    }
+    if (allocation == NULL) {
+        free(homes);
+        free(ends);
+        free(last);
+        return 1;
+    }
+    /* Every file declares the globals it assigns as common symbols, which
+     * the assembler merges. */
+    for (int i = 0; i < ir->globals.size; i++) {
+        const char *size = ir->globals.values[i].type == TYPE_INT ? ",4,4\n"
+                                                                  : ",8,8\n";
+        writer_str(out, "\t.comm\tv_");
+        writer_str(out, ir->globals.values[i].name);
+        writer_str(out, size);
+        writer_str(out, "\t.comm\tp_");
+        writer_str(out, ir->globals.values[i].name);
+        writer_str(out, ",1,1\n");
+    }
+    if (allocation->spill_slots > 0) {
+        writer_str(out, "\t.local\tt_spill_");
+        writer_int(out, unit);
+        writer_str(out, "\n\t.comm\tt_spill_");
+        writer_int(out, unit);
+        writer_char(out, ',');
+        writer_int(out, 8 * (long)allocation->spill_slots);
+        writer_str(out, ",8\n");
+    }
+    writer_str(out, "\t.text\n");
+    UnitCode code = { ir, allocation, homes, ends, last, unit, out };
+    run_function(&code);
+    print_function(ir, unit, out);
+    free_RegisterAllocation(allocation);
+    free(homes);
+    free(ends);
+    free(last);
+    return 0;
+}
+
+void asmgen_main(int units, Writer *out) {
+    writer_str(out, "\t.text\n\t.globl\tmain\nmain:\n\tsubq\t$8, %rsp\n");
+    for (int unit = 0; unit < units; unit++) {
+        instruction("call", out);
+        writer_str(out, "t_run_");
+        writer_int(out, unit);
+        writer_char(out, '\n');
+    }
+    for (int unit = 0; unit < units; unit++) {
+        instruction("call", out);
+        writer_str(out, "t_print_");
+        writer_int(out, unit);
+        writer_char(out, '\n');
+    }
+    writer_str(out, "\txorl\t%eax, %eax\n\taddq\t$8, %rsp\n\tret\n");
+    // No executable stack
+    writer_str(out, "\t.section .note.GNU-stack,\"\",@progbits\n");
+}
@@ -1,348 +1,393 @@
 #include "ast.h"
+#include "ast_flat.h"
+#include "ast_walk.h"
 #include <stdlib.h>
 #include <string.h>
 #include "Tlang_parser.h"
 
 #define UNUSED __attribute__ ((unused))
 
-static void json_vector(const Vector *vec, int indent, FILE *out);
+static void free_arena_node(UNUSED const ASTNode *node) {
+    // Nodes, locations and names are released together with their arena
+}
 
-void free_ASTNode(const void *this) {
-    // Call the vtable->free() function on any subtype of an AST node
-    const ASTNode *node = this;
-    ASTNodeVTable *vtable = node->vtable;
-    vtable->free(node);
+static int no_children(UNUSED const ASTNode *node) {
+    return 0;
 }
 
-static void free_leaf(const void *this) {
-    const ASTNode *node = this;
-    ASTNodeData *data = node->data;
-    free(data->loc);
-    free(node->data);
-    free(node->vtable);
-    free((void*)node);
-}
-
-static void json_leaf(const void *this, int indent, FILE *out) {
-    fprintf(out, "{\n");
-    indent++;
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"type\": \"Leaf Node\",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    const ASTNode *node = this;
-    ASTNodeData *data = node->data;
-    fprintf(out, "\"loc\": \"%d:%d-%d:%d\"", data->loc->first_line, 
-            data->loc->first_column, data->loc->last_line,
-        data->loc->last_column);
-    fprintf(out, "\n");
-    indent--;
-    fprintf(out, "%*s}", indent * JSON_TAB_WIDTH, "");
+static const ASTNode *no_child(UNUSED const ASTNode *node, UNUSED int slot) {
+    return NULL;
 }
 
-const ASTNode *new_LeafNode(struct YYLTYPE *loc) {
-    ASTNode *node = malloc(sizeof(*node));
-    if (node == NULL) {
-        return NULL;
+static int no_json_child(UNUSED const ASTNode *node, UNUSED int slot,
+                         int indent, UNUSED Writer *out) {
+    return indent;
+}
+
+static void json_close(UNUSED const ASTNode *node, int indent, Writer *out) {
+    json_close_node(indent, out);
+}
+
+static void json_loc(const ASTLocation *loc, Writer *out) {
+    writer_key(out, "loc");
+    writer_char(out, '"');
+    writer_int(out, loc->first_line);
+    writer_char(out, ':');
+    writer_int(out, loc->first_column);
+    writer_char(out, '-');
+    writer_int(out, loc->last_line);
+    writer_char(out, ':');
+    writer_int(out, loc->last_column);
+    writer_char(out, '"');
+}
+
+void json_open_node(const char *type, const ASTLocation *loc, int indent,
+                    Writer *out) {
+    writer_char(out, '{');
+    writer_indent(out, indent + 1);
+    writer_key(out, "type");
+    writer_char(out, '"');
+    writer_str(out, type);
+    writer_bytes(out, "\",", 2);
+    writer_indent(out, indent + 1);
+    json_loc(loc, out);
+}
+
+void json_close_node(int indent, Writer *out) {
+    writer_indent(out, indent);
+    writer_char(out, '}');
+}
+
+// Start the next field of an open node: "<key>": on a new line
+static void json_field(const char *key, int indent, Writer *out) {
+    writer_char(out, ',');
+    writer_indent(out, indent + 1);
+    writer_key(out, key);
+}
+
+static void json_leaf(const ASTNode *node, int indent, Writer *out) {
+    json_open_node("Leaf Node", &node->loc, indent, out);
+}
+
+static void free_program(const ASTNode *node) {
+    // The statement nodes belong to the arena; only the Vector is on the heap
+    const ASTProgramData *data = &node->data.program;
+    data->statements->free(data->statements, NULL);
+}
+
+static int program_children(const ASTNode *node) {
+    const Vector *statements = node->data.program.statements;
+    return statements->size(statements);
+}
+
+static const ASTNode *program_child(const ASTNode *node, int slot) {
+    const Vector *statements = node->data.program.statements;
+    const ASTNode *const *nodes =
+        (const ASTNode *const *)statements->view(statements, NULL);
+    return nodes[slot];
+}
+
+static void json_program(const ASTNode *node, int indent, Writer *out) {
+    json_open_node("Program", &node->loc, indent, out);
+    json_field("statements", indent, out);
+    writer_char(out, '[');
+}
+
+static int json_program_child(UNUSED const ASTNode *node, int slot,
+                              int indent, Writer *out) {
+    // Statements are elements of an array nested in the program object
+    if (slot > 0) {
+        writer_char(out, ',');
     }
-    ASTNodeData *data = malloc(sizeof(*data));
-    if (data == NULL) {
-        free(node);
-        return NULL;
+    writer_indent(out, indent + 2);
+    return indent + 2;
+}
+
+static void json_close_program(const ASTNode *node, int indent, Writer *out) {
+    if (program_children(node) > 0) {
+        writer_indent(out, indent + 1);
     }
-    node->data = data;
-    ASTNodeVTable *vtable = malloc(sizeof(*vtable));
-    if (vtable == NULL) {
-        free(node->data);
-        free(node);
-        return NULL;
+    writer_char(out, ']');
+    json_close_node(indent, out);
+}
+
+static int assignment_children(UNUSED const ASTNode *node) {
+    return 2;
+}
+
+static const ASTNode *assignment_child(const ASTNode *node, int slot) {
+    const ASTAssignmentData *data = &node->data.assignment;
+    return slot == 0 ? data->lhs : data->rhs;
+}
+
+static void json_assignment(const ASTNode *node, int indent, Writer *out) {
+    json_open_node("Assignment", &node->loc, indent, out);
+}
+
+static int json_assignment_child(UNUSED const ASTNode *node, int slot,
+                                 int indent, Writer *out) {
+    json_field(slot == 0 ? "lhs" : "rhs", indent, out);
+    return indent + 1;
+}
+
+static void json_variable(const ASTNode *node, int indent, Writer *out) {
+    const ASTVariableData *data = &node->data.variable;
+    json_open_node("Variable", &node->loc, indent, out);
+    json_field("name", indent, out);
+    writer_char(out, '"');
+    writer_bytes(out, data->name->name, data->name->len);
+    writer_char(out, '"');
+}
+
+static void json_int(const ASTNode *node, int indent, Writer *out) {
+    const ASTIntData *data = &node->data.integer;
+    json_open_node("Int", &node->loc, indent, out);
+    json_field("value", indent, out);
+    writer_char(out, '"');
+    writer_int(out, data->val);
+    writer_char(out, '"');
+}
+
+static void json_double(const ASTNode *node, int indent, Writer *out) {
+    const ASTDoubleData *data = &node->data.real;
+    json_open_node("Double", &node->loc, indent, out);
+    json_field("value", indent, out);
+    writer_char(out, '"');
+    writer_double(out, data->val);
+    writer_char(out, '"');
+}
+
+static const ASTNodeVTable leaf_vtable = {
+    .free        = free_arena_node,
+    .child_count = no_children,
+    .child       = no_child,
+    .json        = json_leaf,
+    .json_child  = no_json_child,
+    .json_close  = json_close
+};
+static const ASTNodeVTable program_vtable = {
+    .free        = free_program,
+    .child_count = program_children,
+    .child       = program_child,
+    .json        = json_program,
+    .json_child  = json_program_child,
+    .json_close  = json_close_program
+};
+static const ASTNodeVTable assignment_vtable = {
+    .free        = free_arena_node,
+    .child_count = assignment_children,
+    .child       = assignment_child,
+    .json        = json_assignment,
+    .json_child  = json_assignment_child,
+    .json_close  = json_close
+};
+static const ASTNodeVTable variable_vtable = {
+    .free        = free_arena_node,
+    .child_count = no_children,
+    .child       = no_child,
+    .json        = json_variable,
+    .json_child  = no_json_child,
+    .json_close  = json_close
+};
+static const ASTNodeVTable int_vtable = {
+    .free        = free_arena_node,
+    .child_count = no_children,
+    .child       = no_child,
+    .json        = json_int,
+    .json_child  = no_json_child,
+    .json_close  = json_close
+};
+static const ASTNodeVTable double_vtable = {
+    .free        = free_arena_node,
+    .child_count = no_children,
+    .child       = no_child,
+    .json        = json_double,
+    .json_child  = no_json_child,
+    .json_close  = json_close
+};
+
+static const ASTNodeVTable *const vtables[AST_KIND_COUNT] = {
+    [AST_LEAF]       = &leaf_vtable,
+    [AST_PROGRAM]    = &program_vtable,
+    [AST_ASSIGNMENT] = &assignment_vtable,
+    [AST_VARIABLE]   = &variable_vtable,
+    [AST_INT]        = &int_vtable,
+    [AST_DOUBLE]     = &double_vtable
+};
+
+const ASTNodeVTable *vtable_ASTNode(const ASTNode *node) {
+    return vtables[node->kind];
+}
+
+void free_ASTNode(const void *this) {
+    /* Every node but a Program lives wholly in the arena, and programs never
+     * nest, so there is no need to walk the tree: only this node's own free()
+     * can release anything. */
+    const ASTNode *node = this;
+    vtables[node->kind]->free(node);
+}
+
+typedef struct json_walk {
+    Writer *out;
+    int    indent;
+} JSONWalk;
+
+// Each frame's data is the indentation of its node
+static int json_enter(ASTWalkFrame *frame, ASTWalkFrame *parent, void *ctx) {
+    JSONWalk *json = ctx;
+    if (parent == NULL) {
+        frame->data = json->indent;
+    } else {
+        const ASTNodeVTable *vtable = vtables[parent->node->kind];
+        frame->data = vtable->json_child(parent->node, frame->slot,
+                                         parent->data, json->out);
     }
-    node->vtable = vtable;
-    data->loc = malloc(sizeof(*loc));
-    if (data->loc == NULL) {
-        free(vtable);
-        free(data);
-        free(node);
+    vtables[frame->node->kind]->json(frame->node, frame->data, json->out);
+    return 0;
+}
+
+static void json_leave(ASTWalkFrame *frame, UNUSED ASTWalkFrame *parent,
+                       void *ctx) {
+    JSONWalk *json = ctx;
+    vtables[frame->node->kind]->json_close(frame->node, frame->data,
+                                           json->out);
+}
+
+int json_ASTNode(const ASTNode *node, int indent, Writer *out) {
+    JSONWalk json = { out, indent };
+    return walk_ASTNode(node, json_enter, json_leave, &json, NULL);
+}
+
+static ASTNode *new_ASTNode(const ASTBuilder *builder,
+                            ASTNodeKind kind,
+                            struct YYLTYPE *loc) {
+    const Arena *arena = builder->arena;
+    ASTNode *node = arena->alloc(arena, sizeof(*node));
+    if (node == NULL) {
         return NULL;
     }
-    memcpy(data->loc, loc, sizeof(*loc));
-    vtable->free = free_leaf;
-    vtable->json = json_leaf;
+    node->kind = kind;
+    node->ref = AST_REF_NONE;
+    node->loc.first_line   = loc->first_line;
+    node->loc.first_column = loc->first_column;
+    node->loc.last_line    = loc->last_line;
+    node->loc.last_column  = loc->last_column;
     return node;
 }
 
-static void free_program(const void *this) {
-    const ASTNode *node = this;
-    ASTProgramData *data = node->data;
-    data->statements->free(data->statements, free_ASTNode);
-    free(data->loc);
-    free(node->data);
-    free(node->vtable);
-    free((void*)node);
-}
-
-static void json_program(const void *this, int indent, FILE *out) {
-    fprintf(out, "{\n");
-    indent++;
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"type\": \"Program\",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    const ASTNode *node = this;
-    ASTProgramData *data = node->data;
-    fprintf(out, "\"loc\": \"%d:%d-%d:%d\",\n", data->loc->first_line, 
-            data->loc->first_column, data->loc->last_line,
-            data->loc->last_column);
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"statements\": ");
-    json_vector(data->statements, indent, out);
-    fprintf(out, "\n");
-    indent--;
-    fprintf(out, "%*s}", indent * JSON_TAB_WIDTH, "");
-}
-
-const ASTNode *new_ProgramNode(struct YYLTYPE *loc, const Vector *statements) {
-    ASTNode *node = malloc(sizeof(*node));
+const ASTNode *new_LeafNode(const ASTBuilder *builder, struct YYLTYPE *loc) {
+    ASTNode *node = new_ASTNode(builder, AST_LEAF, loc);
     if (node == NULL) {
         return NULL;
     }
-    struct ast_program_data *data = malloc(sizeof(*data));
-    if (data == NULL) {
-        free(node);
-        return NULL;
-    }
-    node->data = data;
-    struct ast_program_vtable *vtable = malloc(sizeof(*vtable));
-    if (vtable == NULL) {
-        free(data);
-        free(node);
-        return NULL;
-    }
-    node->vtable = vtable;
-    data->loc = malloc(sizeof(*loc));
-    if (data->loc == NULL) {
-        free(vtable);
-        free(data);
-        free(node);
-        return NULL;
+    if (builder->flat) {
+        node->ref = flat_add_leaf(builder->flat, &node->loc);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
+        }
     }
-    memcpy(data->loc, loc, sizeof(*loc));
-    if (statements)
-        data->statements = statements;
-    else
-        data->statements = new_Vector(0);
-    vtable->free = free_program;
-    vtable->json = json_program;
     return node;
 }
 
-static void free_assignment(const void *this) {
-    const ASTNode *node = this;
-    ASTAssignmentData *data = node->data;
-    free_ASTNode(data->lhs);
-    free_ASTNode(data->rhs);
-    free(data->loc);
-    free(node->data);
-    free(node->vtable);
-    free((void*)node);
-}
-
-static void json_assignment(const void *this, int indent, FILE *out) {
-    fprintf(out, "{\n");
-    indent++;
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"type\": \"Assignment\",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    const ASTNode *node = this;
-    ASTAssignmentData *data = node->data;
-    fprintf(out, "\"loc\": \"%d:%d-%d:%d\",\n", data->loc->first_line,
-        data->loc->first_column, data->loc->last_line,
-        data->loc->last_column);
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"lhs\": ");
-    node = data->lhs;
-    ASTNodeVTable *vtable = node->vtable;
-    vtable->json(node, indent, out);
-    fprintf(out, ",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"rhs\": ");
-    node = data->rhs;
-    vtable = node->vtable;
-    vtable->json(node, indent, out);
-    fprintf(out, "\n");
-    indent--;
-    fprintf(out, "%*s}", indent * JSON_TAB_WIDTH, "");
-}
-
-const ASTNode *new_AssignmentNode(struct YYLTYPE *loc, const void *lhs,
-                                  const void *rhs) {
-    ASTNode *node = malloc(sizeof(*node));
+const ASTNode *new_ProgramNode(const ASTBuilder *builder, struct YYLTYPE *loc,
+                               const Vector *statements) {
+    ASTNode *node = new_ASTNode(builder, AST_PROGRAM, loc);
     if (node == NULL) {
         return NULL;
     }
-    struct ast_assignment_data *data = malloc(sizeof(*data));
-    if (data == NULL) {
-        free(node);
-        return NULL;
-    }
-    node->data = data;
-    struct ast_assignment_vtable *vtable = malloc(sizeof(*vtable));
-    if (vtable == NULL) {
-        free(data);
-        free(node);
+    if (statements)
+        node->data.program.statements = statements;
+    else
+        node->data.program.statements = new_Vector(0);
+    statements = node->data.program.statements;
+    if (statements == NULL) {
         return NULL;
     }
-    node->vtable = vtable;
-    data->loc = malloc(sizeof(*loc));
-    if (data->loc == NULL) {
-        free(vtable);
-        free(data);
-        free(node);
-        return NULL;
+    // The statement list is complete, so give back the spare capacity
+    statements->shrink_to_fit(statements);
+    if (builder->flat) {
+        int count;
+        const ASTNode *const *stmts =
+            (const ASTNode *const *)statements->view(statements, &count);
+        ASTRef *refs = builder->arena->alloc(builder->arena,
+                                             count * sizeof(*refs));
+        if (refs == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < count; i++) {
+            refs[i] = stmts[i]->ref;
+        }
+        node->ref = flat_add_program(builder->flat, &node->loc, refs, count);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
+        }
     }
-    memcpy(data->loc, loc, sizeof(*loc));
-    data->lhs = lhs;
-    data->rhs = rhs;
-    vtable->free = free_assignment;
-    vtable->json = json_assignment;
     return node;
 }
 
-static void free_variable(const void *this) {
-    const ASTNode *node = this;
-    ASTVariableData *data = node->data;
-    free(data->name);
-    free(data->loc);
-    free(node->data);
-    free(node->vtable);
-    free((void*)node);
-}
-
-static void json_variable(const void *this, int indent, FILE *out) {
-    fprintf(out, "{\n");
-    indent++;
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"type\": \"Variable\",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    const ASTNode *node = this;
-    ASTVariableData *data = node->data;
-    fprintf(out, "\"loc\": \"%d:%d-%d:%d\",\n", data->loc->first_line,
-        data->loc->first_column, data->loc->last_line,
-        data->loc->last_column);
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"name\": ");
-    fprintf(out, "\"%s\"\n", data->name);
-    indent--;
-    fprintf(out, "%*s}", indent * JSON_TAB_WIDTH, "");
-}
-
-const ASTNode *new_VariableNode(struct YYLTYPE *loc, char *name) {
-    ASTNode *node = malloc(sizeof(*node));
+const ASTNode *new_AssignmentNode(const ASTBuilder *builder,
+                                  struct YYLTYPE *loc,
+                                  const ASTNode *lhs, const ASTNode *rhs) {
+    ASTNode *node = new_ASTNode(builder, AST_ASSIGNMENT, loc);
     if (node == NULL) {
         return NULL;
     }
-    struct ast_variable_data *data = malloc(sizeof(*data));
-    if (data == NULL) {
-        free(node);
-        return NULL;
-    }
-    node->data = data;
-    struct ast_variable_vtable *vtable = malloc(sizeof(*vtable));
-    if (vtable == NULL) {
-        free(data);
-        free(node);
-        return NULL;
-    }
-    node->vtable = vtable;
-    data->loc = malloc(sizeof(*loc));
-    if (data->loc == NULL) {
-        free(vtable);
-        free(data);
-        free(node);
-        return NULL;
+    node->data.assignment.lhs = lhs;
+    node->data.assignment.rhs = rhs;
+    if (builder->flat) {
+        node->ref = flat_add_assignment(builder->flat, &node->loc,
+                                        lhs->ref, rhs->ref);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
+        }
     }
-    memcpy(data->loc, loc, sizeof(*loc));
-    data->name = name;
-    vtable->free = free_variable;
-    vtable->json = json_variable;
     return node;
 }
 
-static void free_int(const void *this) {
-    const ASTNode *node = this;
-    ASTIntData *data = node->data;
-    free(data->loc);
-    free(node->data);
-    free(node->vtable);
-    free((void*)node);
-}
-
-static void json_int(const void *this, int indent, FILE *out) {
-    fprintf(out, "{\n");
-    indent++;
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"type\": \"Int\",\n");
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    const ASTNode *node = this;
-    ASTIntData *data = node->data;
-    fprintf(out, "\"loc\": \"%d:%d-%d:%d\",\n", data->loc->first_line,
-        data->loc->first_column, data->loc->last_line,
-        data->loc->last_column);
-    fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-    fprintf(out, "\"value\": ");
-    fprintf(out, "\"%d\"\n", data->val);
-    indent--;
-    fprintf(out, "%*s}", indent * JSON_TAB_WIDTH, "");
-}
-
-const ASTNode *new_IntNode(struct YYLTYPE *loc, int val) {
-    ASTNode *node = malloc(sizeof(*node));
+const ASTNode *new_VariableNode(const ASTBuilder *builder,
+                                struct YYLTYPE *loc, const Symbol *name) {
+    ASTNode *node = new_ASTNode(builder, AST_VARIABLE, loc);
     if (node == NULL) {
         return NULL;
     }
-    struct ast_int_data *data = malloc(sizeof(*data));
-    if (data == NULL) {
-        free(node);
-        return NULL;
+    node->data.variable.name = name;
+    if (builder->flat) {
+        node->ref = flat_add_variable(builder->flat, &node->loc, name);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
+        }
     }
-    node->data = data;
-    struct ast_int_vtable *vtable = malloc(sizeof(*vtable));
-    if (vtable == NULL) {
-        free(data);
-        free(node);
+    return node;
+}
+
+const ASTNode *new_IntNode(const ASTBuilder *builder, struct YYLTYPE *loc,
+                           int val) {
+    ASTNode *node = new_ASTNode(builder, AST_INT, loc);
+    if (node == NULL) {
         return NULL;
     }
-    node->vtable = vtable;
-    data->loc = malloc(sizeof(*loc));
-    if (data->loc == NULL) {
-        free(vtable);
-        free(data);
-        free(node);
-        return NULL;
+    node->data.integer.val = val;
+    if (builder->flat) {
+        node->ref = flat_add_int(builder->flat, &node->loc, val);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
+        }
     }
-    memcpy(data->loc, loc, sizeof(*loc));
-    data->val = val;
-    vtable->free = free_int;
-    vtable->json = json_int;
     return node;
 }
 
-static void json_vector(const Vector *vec, int indent, FILE *out) {
-    char *sep = "\n";
-    fprintf(out, "[");
-    int size = vec->size(vec);
-    if (size > 0) {
-        indent++;
-        for (int i = 0; i < size; i++) {
-            fprintf(out, "%s", sep);
-            fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
-            const ASTNode *node = NULL;
-            if (vec->get(vec, i, &node)) return;
-            ASTNodeVTable *vtable = node->vtable;
-            vtable->json(node, indent, out);
-            sep = ",\n";
+const ASTNode *new_DoubleNode(const ASTBuilder *builder, struct YYLTYPE *loc,
+                              double val) {
+    ASTNode *node = new_ASTNode(builder, AST_DOUBLE, loc);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->data.real.val = val;
+    if (builder->flat) {
+        node->ref = flat_add_double(builder->flat, &node->loc, val);
+        if (node->ref == AST_REF_NONE) {
+            return NULL;
         }
-        fprintf(out, "\n");
-        indent--;
-        fprintf(out, "%*s", indent * JSON_TAB_WIDTH, "");
     }
-    fprintf(out, "]");
+    return node;
 }
@@ -0,0 +1,219 @@
+#include "ast_bin.h"
+#include <stdlib.h>
+#include <string.h> // memcmp(), memcpy()
+#include <errno.h>
+#include <fcntl.h>  // open()
+#include <unistd.h> // close()
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PADDING(size) (-(size) & (AST_BIN_ALIGNMENT - 1))
+
+// Sections after the per-kind location arrays, in file order
+enum {
+    SECTION_PROGRAMS = AST_KIND_COUNT,
+    SECTION_ASSIGNMENTS,
+    SECTION_VARIABLES,
+    SECTION_INTS,
+    SECTION_DOUBLES,
+    SECTION_CHILDREN,
+    SECTION_STRINGS,
+    SECTION_COUNT
+};
+
+typedef struct section {
+    void   **array;     // The ASTFlat member holding the section's array
+    size_t size;        // In bytes
+} Section;
+
+/* The writer and the loader both lay out the file from this table, so they
+ * can't disagree on the order or size of the sections. */
+static void find_sections(ASTFlat *flat, const ASTBinHeader *header,
+                          Section sections[SECTION_COUNT]) {
+    const uint32_t *counts = header->counts;
+    for (int kind = 0; kind < AST_KIND_COUNT; kind++) {
+        sections[kind] = (Section){
+            (void**)&flat->locs[kind], counts[kind] * sizeof(ASTLocation)
+        };
+    }
+    sections[SECTION_PROGRAMS] = (Section){
+        (void**)&flat->programs, counts[AST_PROGRAM] * sizeof(FlatProgram)
+    };
+    sections[SECTION_ASSIGNMENTS] = (Section){
+        (void**)&flat->assignments,
+        counts[AST_ASSIGNMENT] * sizeof(FlatAssignment)
+    };
+    sections[SECTION_VARIABLES] = (Section){
+        (void**)&flat->variables, counts[AST_VARIABLE] * sizeof(FlatVariable)
+    };
+    sections[SECTION_INTS] = (Section){
+        (void**)&flat->ints, counts[AST_INT] * sizeof(FlatInt)
+    };
+    sections[SECTION_DOUBLES] = (Section){
+        (void**)&flat->doubles, counts[AST_DOUBLE] * sizeof(FlatDouble)
+    };
+    sections[SECTION_CHILDREN] = (Section){
+        (void**)&flat->children, header->children_size * sizeof(ASTRef)
+    };
+    sections[SECTION_STRINGS] = (Section){
+        (void**)&flat->strings, header->strings_size
+    };
+}
+
+static int write_padded(const void *data, size_t size, FILE *out) {
+    static const char zeros[AST_BIN_ALIGNMENT];
+    if (size > 0 && fwrite(data, size, 1, out) != 1) {
+        return 1;
+    }
+    size_t padding = PADDING(size);
+    if (padding > 0 && fwrite(zeros, padding, 1, out) != 1) {
+        return 1;
+    }
+    return 0;
+}
+
+int write_ASTBin(const ASTFlat *flat, ASTRef root, FILE *out) {
+    ASTBinHeader header = {
+        .magic = AST_BIN_MAGIC,
+        .version = AST_BIN_VERSION,
+        .byte_order = AST_BIN_BYTE_ORDER,
+        .root = root,
+        .children_size = flat->children_size,
+        .strings_size = flat->strings_size
+    };
+    memcpy(header.counts, flat->sizes, sizeof(header.counts));
+    Section sections[SECTION_COUNT];
+    // Only reads through the section table, so dropping const is safe
+    find_sections((ASTFlat*)flat, &header, sections);
+    if (write_padded(&header, sizeof(header), out)) {
+        return 1;
+    }
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (write_padded(*sections[i].array, sections[i].size, out)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether ref is the handle of a node in the file
+static int valid_ref(const ASTBinHeader *header, ASTRef ref) {
+    ASTNodeKind kind = AST_REF_KIND(ref);
+    return kind < AST_KIND_COUNT && AST_REF_INDEX(ref) < header->counts[kind];
+}
+
+/* Check every handle and offset in the node arrays, so readers can follow
+ * them without bounds checks. The parser never nests programs, and builds
+ * an assignment after its value, so requiring the same of the file also
+ * rules out cycles. */
+static int check_nodes(const ASTFlat *flat, const ASTBinHeader *header) {
+    for (uint32_t i = 0; i < header->counts[AST_PROGRAM]; i++) {
+        const FlatProgram *program = &flat->programs[i];
+        if (program->first > header->children_size ||
+            program->count > header->children_size - program->first) {
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < header->children_size; i++) {
+        if (!valid_ref(header, flat->children[i]) ||
+            AST_REF_KIND(flat->children[i]) == AST_PROGRAM) {
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < header->counts[AST_ASSIGNMENT]; i++) {
+        const FlatAssignment *assignment = &flat->assignments[i];
+        ASTNodeKind rhs_kind = AST_REF_KIND(assignment->rhs);
+        if (!valid_ref(header, assignment->lhs) ||
+            AST_REF_KIND(assignment->lhs) != AST_VARIABLE ||
+            !valid_ref(header, assignment->rhs) ||
+            rhs_kind == AST_PROGRAM ||
+            (rhs_kind == AST_ASSIGNMENT &&
+             AST_REF_INDEX(assignment->rhs) >= i)) {
+            return 1;
+        }
+    }
+    // The string table ends in a NUL, so every name in it is terminated
+    for (uint32_t i = 0; i < header->counts[AST_VARIABLE]; i++) {
+        if (flat->variables[i].name >= header->strings_size) {
+            return 1;
+        }
+    }
+    return !valid_ref(header, header->root);
+}
+
+// Check the header, and point flat's arrays at the sections that follow it
+static int map_sections(ASTBin *bin) {
+    const ASTBinHeader *header = bin->map;
+    if (bin->size < sizeof(*header) ||
+        memcmp(header->magic, AST_BIN_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != AST_BIN_VERSION ||
+        header->byte_order != AST_BIN_BYTE_ORDER) {
+        return 1;
+    }
+    Section sections[SECTION_COUNT];
+    find_sections(&bin->flat, header, sections);
+    size_t offset = sizeof(*header) + PADDING(sizeof(*header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (sections[i].size > bin->size ||
+            offset > bin->size - sections[i].size) {
+            return 1;
+        }
+        *sections[i].array = (char*)bin->map + offset;
+        offset += sections[i].size + PADDING(sections[i].size);
+    }
+    // Names are read as C strings, so the table must end in a NUL
+    if (header->strings_size > 0 &&
+        bin->flat.strings[header->strings_size - 1] != '\0') {
+        return 1;
+    }
+    if (check_nodes(&bin->flat, header)) {
+        return 1;
+    }
+    memcpy(bin->flat.sizes, header->counts, sizeof(bin->flat.sizes));
+    bin->flat.children_size = header->children_size;
+    bin->flat.strings_size = header->strings_size;
+    bin->root = header->root;
+    return 0;
+}
+
+ASTBin *load_ASTBin(const char *filename) {
+    ASTBin *bin = calloc(1, sizeof(*bin));
+    if (bin == NULL) {
+        return NULL;
+    }
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        free(bin);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        free(bin);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(ASTBinHeader)) {
+        close(fd);
+        free(bin);
+        errno = EINVAL;
+        return NULL;
+    }
+    bin->size = st.st_size;
+    bin->map = mmap(NULL, bin->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bin->map == MAP_FAILED) {
+        free(bin);
+        return NULL;
+    }
+    if (map_sections(bin)) {
+        free_ASTBin(bin);
+        errno = EINVAL;
+        return NULL;
+    }
+    return bin;
+}
+
+void free_ASTBin(ASTBin *bin) {
+    munmap(bin->map, bin->size);
+    free(bin);
+}
@@ -0,0 +1,321 @@
+#include "ast_flat.h"
+#include <stdlib.h>
+#include <string.h> // memcpy()
+#include "stack.h"
+
+/* Size of the kind-specific fields stored for each node kind */
+static const size_t item_sizes[AST_KIND_COUNT] = {
+    [AST_LEAF]       = 0,
+    [AST_PROGRAM]    = sizeof(FlatProgram),
+    [AST_ASSIGNMENT] = sizeof(FlatAssignment),
+    [AST_VARIABLE]   = sizeof(FlatVariable),
+    [AST_INT]        = sizeof(FlatInt),
+    [AST_DOUBLE]     = sizeof(FlatDouble)
+};
+
+/* Make room for 'count' more elements of 'size' bytes in '*array', doubling
+ * its capacity as needed. */
+static int reserve(void *array, uint32_t *capacity, uint32_t used,
+                   uint32_t count, size_t size) {
+    if (used + count <= *capacity) {
+        return 0;
+    }
+    uint32_t new_cap = *capacity > 0 ? *capacity : AST_FLAT_CAPACITY;
+    while (new_cap < used + count) {
+        new_cap *= 2;
+    }
+    void *new_array = realloc(*(void**)array, new_cap * size);
+    if (new_array == NULL) {
+        return 1;
+    }
+    *(void**)array = new_array;
+    *capacity = new_cap;
+    return 0;
+}
+
+static void **items(ASTFlat *flat, ASTNodeKind kind) {
+    switch (kind) {
+        case AST_PROGRAM:    return (void**)&flat->programs;
+        case AST_ASSIGNMENT: return (void**)&flat->assignments;
+        case AST_VARIABLE:   return (void**)&flat->variables;
+        case AST_INT:        return (void**)&flat->ints;
+        case AST_DOUBLE:     return (void**)&flat->doubles;
+        default:             return NULL;
+    }
+}
+
+/* Append a node of the given kind, leaving its fields to the caller */
+static int add_node(ASTFlat *flat, ASTNodeKind kind, const ASTLocation *loc,
+                    ASTRef *ref) {
+    uint32_t index = flat->sizes[kind];
+    if (index > AST_REF_INDEX_MASK) {
+        return 1;
+    }
+    uint32_t cap = flat->capacities[kind];
+    if (reserve(&flat->locs[kind], &cap, index, 1, sizeof(*loc))) {
+        return 1;
+    }
+    void **array = items(flat, kind);
+    if (array != NULL) {
+        cap = flat->capacities[kind];
+        if (reserve(array, &cap, index, 1, item_sizes[kind])) {
+            return 1;
+        }
+    }
+    flat->capacities[kind] = cap;
+    flat->locs[kind][index] = *loc;
+    flat->sizes[kind]++;
+    *ref = AST_REF(kind, index);
+    return 0;
+}
+
+ASTRef flat_add_leaf(ASTFlat *flat, const ASTLocation *loc) {
+    ASTRef ref;
+    if (add_node(flat, AST_LEAF, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    return ref;
+}
+
+ASTRef flat_add_program(ASTFlat *flat, const ASTLocation *loc,
+                        const ASTRef *statements, uint32_t count) {
+    if (reserve(&flat->children, &flat->children_capacity,
+                flat->children_size, count, sizeof(*statements))) {
+        return AST_REF_NONE;
+    }
+    ASTRef ref;
+    if (add_node(flat, AST_PROGRAM, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    FlatProgram *program = &flat->programs[AST_REF_INDEX(ref)];
+    program->first = flat->children_size;
+    program->count = count;
+    memcpy(flat->children + flat->children_size, statements,
+           count * sizeof(*statements));
+    flat->children_size += count;
+    return ref;
+}
+
+ASTRef flat_add_assignment(ASTFlat *flat, const ASTLocation *loc,
+                           ASTRef lhs, ASTRef rhs) {
+    ASTRef ref;
+    if (add_node(flat, AST_ASSIGNMENT, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    FlatAssignment *assignment = &flat->assignments[AST_REF_INDEX(ref)];
+    assignment->lhs = lhs;
+    assignment->rhs = rhs;
+    return ref;
+}
+
+/* Offset of a symbol's name in the string table, adding it the first time
+ * the symbol is seen so every name is stored once. */
+static uint32_t name_offset(ASTFlat *flat, const Symbol *name) {
+    uint32_t cap = flat->name_offsets_capacity;
+    if (reserve(&flat->name_offsets, &flat->name_offsets_capacity, name->id,
+                1, sizeof(*flat->name_offsets))) {
+        return UINT32_MAX;
+    }
+    for (; cap < flat->name_offsets_capacity; cap++) {
+        flat->name_offsets[cap] = UINT32_MAX;
+    }
+    if (flat->name_offsets[name->id] != UINT32_MAX) {
+        return flat->name_offsets[name->id];
+    }
+    // Names are stored NUL-terminated, so they can be used as C strings
+    uint32_t len = name->len + 1;
+    if (reserve(&flat->strings, &flat->strings_capacity, flat->strings_size,
+                len, 1)) {
+        return UINT32_MAX;
+    }
+    uint32_t offset = flat->strings_size;
+    memcpy(flat->strings + offset, name->name, len);
+    flat->strings_size += len;
+    flat->name_offsets[name->id] = offset;
+    return offset;
+}
+
+ASTRef flat_add_variable(ASTFlat *flat, const ASTLocation *loc,
+                         const Symbol *name) {
+    uint32_t offset = name_offset(flat, name);
+    if (offset == UINT32_MAX) {
+        return AST_REF_NONE;
+    }
+    ASTRef ref;
+    if (add_node(flat, AST_VARIABLE, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    flat->variables[AST_REF_INDEX(ref)].name = offset;
+    return ref;
+}
+
+ASTRef flat_add_int(ASTFlat *flat, const ASTLocation *loc, int val) {
+    ASTRef ref;
+    if (add_node(flat, AST_INT, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    FlatInt *integer = &flat->ints[AST_REF_INDEX(ref)];
+    integer->val = val;
+    return ref;
+}
+
+ASTRef flat_add_double(ASTFlat *flat, const ASTLocation *loc, double val) {
+    ASTRef ref;
+    if (add_node(flat, AST_DOUBLE, loc, &ref)) {
+        return AST_REF_NONE;
+    }
+    flat->doubles[AST_REF_INDEX(ref)].val = val;
+    return ref;
+}
+
+static uint32_t flat_child_count(const ASTFlat *flat, ASTRef ref) {
+    switch (AST_REF_KIND(ref)) {
+        case AST_PROGRAM:
+            return flat->programs[AST_REF_INDEX(ref)].count;
+        case AST_ASSIGNMENT:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static ASTRef flat_child(const ASTFlat *flat, ASTRef ref, uint32_t slot) {
+    uint32_t index = AST_REF_INDEX(ref);
+    if (AST_REF_KIND(ref) == AST_PROGRAM) {
+        return flat->children[flat->programs[index].first + slot];
+    }
+    return slot == 0 ? flat->assignments[index].lhs
+                     : flat->assignments[index].rhs;
+}
+
+// Open a node and write the fields that aren't children
+static void json_flat_open(const ASTFlat *flat, ASTRef ref, int indent,
+                           Writer *out) {
+    uint32_t index = AST_REF_INDEX(ref);
+    const ASTLocation *loc = &flat->locs[AST_REF_KIND(ref)][index];
+    switch (AST_REF_KIND(ref)) {
+        case AST_PROGRAM:
+            json_open_node("Program", loc, indent, out);
+            writer_char(out, ',');
+            writer_indent(out, indent + 1);
+            writer_key(out, "statements");
+            writer_char(out, '[');
+            break;
+        case AST_ASSIGNMENT:
+            json_open_node("Assignment", loc, indent, out);
+            break;
+        case AST_VARIABLE:
+            json_open_node("Variable", loc, indent, out);
+            writer_char(out, ',');
+            writer_indent(out, indent + 1);
+            writer_key(out, "name");
+            writer_char(out, '"');
+            writer_str(out, flat->strings + flat->variables[index].name);
+            writer_char(out, '"');
+            break;
+        case AST_INT:
+            json_open_node("Int", loc, indent, out);
+            writer_char(out, ',');
+            writer_indent(out, indent + 1);
+            writer_key(out, "value");
+            writer_char(out, '"');
+            writer_int(out, flat->ints[index].val);
+            writer_char(out, '"');
+            break;
+        case AST_DOUBLE:
+            json_open_node("Double", loc, indent, out);
+            writer_char(out, ',');
+            writer_indent(out, indent + 1);
+            writer_key(out, "value");
+            writer_char(out, '"');
+            writer_double(out, flat->doubles[index].val);
+            writer_char(out, '"');
+            break;
+        default:
+            json_open_node("Leaf Node", loc, indent, out);
+    }
+}
+
+// Start the field holding a child, and return the child's indentation
+static int json_flat_child(ASTRef ref, uint32_t slot, int indent,
+                           Writer *out) {
+    if (AST_REF_KIND(ref) == AST_PROGRAM) {
+        if (slot > 0) {
+            writer_char(out, ',');
+        }
+        writer_indent(out, indent + 2);
+        return indent + 2;
+    }
+    writer_char(out, ',');
+    writer_indent(out, indent + 1);
+    writer_key(out, slot == 0 ? "lhs" : "rhs");
+    return indent + 1;
+}
+
+static void json_flat_close(const ASTFlat *flat, ASTRef ref, int indent,
+                            Writer *out) {
+    if (AST_REF_KIND(ref) == AST_PROGRAM) {
+        if (flat_child_count(flat, ref) > 0) {
+            writer_indent(out, indent + 1);
+        }
+        writer_char(out, ']');
+    }
+    json_close_node(indent, out);
+}
+
+typedef struct flat_json_frame {
+    ASTRef   ref;
+    uint32_t next;      // Next child to write
+    int      indent;
+} FlatJSONFrame;
+
+STACK_DEFINE(FlatJSONStack, FlatJSONFrame)
+
+/* Depth-first with an explicit stack, like walk_ASTNode(), so deep
+ * assignment chains don't recurse on the C stack. */
+int json_ASTFlat(const ASTFlat *flat, ASTRef ref, int indent, Writer *out) {
+    FlatJSONStack stack;
+    if (init_FlatJSONStack(&stack, 0)) {
+        return 1;
+    }
+    json_flat_open(flat, ref, indent, out);
+    int status = push_FlatJSONStack(&stack, (FlatJSONFrame){ ref, 0, indent });
+    while (status == 0 && stack.size > 0) {
+        FlatJSONFrame *top = &stack.values[stack.size - 1];
+        if (top->next < flat_child_count(flat, top->ref)) {
+            uint32_t slot = top->next++;
+            FlatJSONFrame frame = {
+                flat_child(flat, top->ref, slot),
+                0,
+                json_flat_child(top->ref, slot, top->indent, out)
+            };
+            json_flat_open(flat, frame.ref, frame.indent, out);
+            status = push_FlatJSONStack(&stack, frame);
+        } else {
+            json_flat_close(flat, top->ref, top->indent, out);
+            stack.size--;
+        }
+    }
+    free_FlatJSONStack(&stack);
+    return status;
+}
+
+ASTFlat *new_ASTFlat(void) {
+    // Every array starts out empty and is allocated on first use
+    return calloc(1, sizeof(ASTFlat));
+}
+
+void free_ASTFlat(ASTFlat *flat) {
+    for (int kind = 0; kind < AST_KIND_COUNT; kind++) {
+        free(flat->locs[kind]);
+    }
+    free(flat->programs);
+    free(flat->assignments);
+    free(flat->variables);
+    free(flat->ints);
+    free(flat->doubles);
+    free(flat->children);
+    free(flat->strings);
+    free(flat->name_offsets);
+    free(flat);
+}
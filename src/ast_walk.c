@@ -0,0 +1,52 @@
+#include "ast_walk.h"
+
+// Push a frame for node and enter it
+static int visit(ASTWalkStack *stack, const ASTNode *node, int slot,
+                 ASTWalkEnter enter, void *ctx) {
+    const ASTNodeVTable *vtable = vtable_ASTNode(node);
+    ASTWalkFrame frame = { node, slot, 0, vtable->child_count(node), 0 };
+    if (push_ASTWalkStack(stack, frame)) {
+        return 1;
+    }
+    ASTWalkFrame *top = &stack->values[stack->size - 1];
+    ASTWalkFrame *parent = stack->size > 1 ? top - 1 : NULL;
+    if (enter != NULL && enter(top, parent, ctx)) {
+        top->count = 0;
+    }
+    return 0;
+}
+
+int walk_ASTNode(const ASTNode *root,
+                 ASTWalkEnter enter,
+                 ASTWalkLeave leave,
+                 void *ctx,
+                 ASTWalkStack *stack) {
+    ASTWalkStack local;
+    if (stack == NULL) {
+        if (init_ASTWalkStack(&local, 0)) {
+            return 1;
+        }
+        stack = &local;
+    }
+    stack->size = 0;
+    int status = visit(stack, root, 0, enter, ctx);
+    while (status == 0 && stack->size > 0) {
+        ASTWalkFrame *top = &stack->values[stack->size - 1];
+        if (top->next < top->count) {
+            const ASTNodeVTable *vtable = vtable_ASTNode(top->node);
+            int slot = top->next++;
+            status = visit(stack, vtable->child(top->node, slot), slot,
+                           enter, ctx);
+        } else {
+            ASTWalkFrame done;
+            pop_ASTWalkStack(stack, &done);
+            if (leave != NULL) {
+                leave(&done, stack->size > 0 ? top - 1 : NULL, ctx);
+            }
+        }
+    }
+    if (stack == &local) {
+        free_ASTWalkStack(&local);
+    }
+    return status;
+}
@@ -0,0 +1,163 @@
+#include "bytecode.h"
+#include <stdlib.h>
+#include <string.h> // strdup(), strlen()
+
+static int emit(Bytecode *unit, Opcode op, uint32_t a, uint32_t b) {
+    Instruction instruction = { op, a, b };
+    return append_Instructions(&unit->code, instruction);
+}
+
+/* Store 'value' into register 'target'. Constants and folded loads are
+ * stored directly; other loads have been saved to a register of their own,
+ * numbered in 'temporaries'. */
+static int store(Bytecode *unit, const IR *ir, const uint32_t *temporaries,
+                 uint32_t target, IRValue value) {
+    uint32_t arg = ir->args[value];
+    switch (ir->ops[value]) {
+        case IR_INT:
+            return emit(unit, OP_INT, target, arg);
+        case IR_DOUBLE:
+            if (emit(unit, OP_DOUBLE, target, unit->constants.size)) {
+                return 1;
+            }
+            return append_BytecodeConstants(&unit->constants,
+                                            ir->constants.values[arg]);
+        case IR_LOAD:
+            return emit(unit, OP_MOVE, target,
+                        is_folded_IR(ir, value) ? arg : temporaries[value]);
+        default:
+            return 0;
+    }
+}
+
+int lower_Bytecode(Bytecode *unit, const IR *ir) {
+    // Globals keep the IR's numbering, and temporaries follow them
+    for (int i = 0; i < ir->globals.size; i++) {
+        BytecodeRegister reg = {
+            strdup(ir->globals.values[i].name), ir->globals.values[i].type
+        };
+        if (reg.name == NULL ||
+            append_BytecodeRegisters(&unit->registers, reg)) {
+            free(reg.name);
+            return 1;
+        }
+    }
+    uint32_t *temporaries = malloc((ir->size + 1) * sizeof(*temporaries));
+    if (temporaries == NULL) {
+        return 1;
+    }
+    int status = 0;
+    for (IRValue v = 0; status == 0 && v < ir->size; v++) {
+        switch (ir->ops[v]) {
+            case IR_LOAD:
+                if (use_count_IR(ir, v) == 0 || is_folded_IR(ir, v)) {
+                    break;
+                }
+                temporaries[v] = unit->registers.size;
+                BytecodeRegister reg = { NULL, ir->types[v] };
+                status = append_BytecodeRegisters(&unit->registers, reg) ||
+                         emit(unit, OP_MOVE, temporaries[v], ir->args[v]);
+                break;
+            case IR_STORE:
+                status = store(unit, ir, temporaries, ir->args[v],
+                               ir->operands[v]);
+                break;
+            default:
+                break;
+        }
+    }
+    free(temporaries);
+    if (unit->registers.size > BYTECODE_MAX_REGISTERS) {
+        return 1;
+    }
+    return status;
+}
+
+int link_Bytecode(Bytecode *program, const Bytecode *unit) {
+    uint32_t *remap = malloc((unit->registers.size + 1) * sizeof(*remap));
+    if (remap == NULL) {
+        return 1;
+    }
+    int status = 0;
+    for (int i = 0; status == 0 && i < unit->registers.size; i++) {
+        const BytecodeRegister *reg = &unit->registers.values[i];
+        size_t len = reg->name != NULL ? strlen(reg->name) : 0;
+        const void *found = NULL;
+        if (reg->name != NULL &&
+            !program->names->get(program->names, reg->name, len, &found)) {
+            remap[i] = (uintptr_t)found - 1;
+            continue;
+        }
+        // A new global, or a temporary, which no other file can share
+        remap[i] = program->registers.size;
+        BytecodeRegister copy = { NULL, reg->type };
+        if ((reg->name != NULL && (copy.name = strdup(reg->name)) == NULL) ||
+            remap[i] >= BYTECODE_MAX_REGISTERS ||
+            append_BytecodeRegisters(&program->registers, copy)) {
+            free(copy.name);
+            status = 1;
+        } else if (reg->name != NULL &&
+                   program->names->put(program->names, reg->name, len,
+                                       (void*)(uintptr_t)(remap[i] + 1),
+                                       NULL)) {
+            status = 1;
+        }
+    }
+    uint32_t first_constant = program->constants.size;
+    if (status == 0 &&
+        (reserve_Instructions(&program->code,
+                              program->code.size + unit->code.size) ||
+         reserve_BytecodeConstants(&program->constants,
+                                   first_constant + unit->constants.size))) {
+        status = 1;
+    }
+    for (int i = 0; status == 0 && i < unit->code.size; i++) {
+        Instruction instruction = unit->code.values[i];
+        instruction.a = remap[instruction.a];
+        if (instruction.op == OP_MOVE) {
+            instruction.b = remap[instruction.b];
+        } else if (instruction.op == OP_DOUBLE) {
+            instruction.b += first_constant;
+        }
+        append_Instructions(&program->code, instruction);
+    }
+    for (int i = 0; status == 0 && i < unit->constants.size; i++) {
+        append_BytecodeConstants(&program->constants,
+                                 unit->constants.values[i]);
+    }
+    free(remap);
+    return status;
+}
+
+int seal_Bytecode(Bytecode *program) {
+    Instruction halt = { OP_HALT, 0, 0 };
+    return append_Instructions(&program->code, halt);
+}
+
+Bytecode *new_Bytecode(void) {
+    Bytecode *bytecode = calloc(1, sizeof(*bytecode));
+    if (bytecode == NULL) {
+        return NULL;
+    }
+    if (init_Instructions(&bytecode->code, 0) ||
+        init_BytecodeConstants(&bytecode->constants, 0) ||
+        init_BytecodeRegisters(&bytecode->registers, 0) ||
+        (bytecode->names = new_Map(0, 0)) == NULL) {
+        free_Bytecode(bytecode);
+        return NULL;
+    }
+    return bytecode;
+}
+
+void free_Bytecode(Bytecode *bytecode) {
+    for (int i = 0; i < bytecode->registers.size; i++) {
+        free(bytecode->registers.values[i].name);
+    }
+    free_Instructions(&bytecode->code);
+    free_BytecodeConstants(&bytecode->constants);
+    free_BytecodeRegisters(&bytecode->registers);
+    if (bytecode->names != NULL) {
+        bytecode->names->free(bytecode->names, NULL);
+    }
+    free(bytecode);
+}
@@ -0,0 +1,222 @@
+#include "codegen.h"
+#include <math.h>   // isinf()
+
+/* Statements per generated C function. C compilers handle many small
+ * functions far better than one huge one, which for files with hundreds of
+ * thousands of statements can exhaust their stack. */
+#define CODEGEN_CHUNK_SIZE 4096
+
+static const char prelude[] =
+    "#include <math.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "static void t_print_int(const char *name, int val) {\n"
+    "    printf(\"%s = %d\\n\", name, val);\n"
+    "}\n"
+    "\n"
+    "static void t_print_double(const char *name, double val) {\n"
+    "    char digits[32];\n"
+    "    snprintf(digits, sizeof(digits), \"%.15g\", val);\n"
+    "    if (strtod(digits, NULL) != val) {\n"
+    "        snprintf(digits, sizeof(digits), \"%.17g\", val);\n"
+    "    }\n"
+    "    printf(\"%s = %s\\n\", name, digits);\n"
+    "}\n";
+
+static const char *const c_types[] = {
+    [TYPE_INT]    = "int",
+    [TYPE_DOUBLE] = "double"
+};
+
+void codegen_prelude(Writer *out) {
+    writer_bytes(out, prelude, sizeof(prelude) - 1);
+}
+
+static void global(const IR *ir, uint32_t index, Writer *out) {
+    writer_bytes(out, "v_", 2);
+    writer_str(out, ir->globals.values[index].name);
+}
+
+// Temporaries hold the loads that aren't folded into their user
+static void temporary(IRValue value, int unit, Writer *out) {
+    writer_str(out, "t_");
+    writer_int(out, unit);
+    writer_char(out, '_');
+    writer_int(out, value);
+}
+
+// A value, as a C expression without side effects
+static void operand(const IR *ir, IRValue value, int unit, Writer *out) {
+    double val;
+    switch (ir->ops[value]) {
+        case IR_INT:
+            writer_int(out, (int32_t)ir->args[value]);
+            break;
+        case IR_DOUBLE:
+            // Literals too long for a double overflow to infinity
+            val = ir->constants.values[ir->args[value]];
+            if (isinf(val)) {
+                writer_str(out, "HUGE_VAL");
+            } else {
+                writer_double(out, val);
+            }
+            break;
+        case IR_LOAD:
+            if (is_folded_IR(ir, value)) {
+                global(ir, ir->args[value], out);
+            } else {
+                temporary(value, unit, out);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* A function made of chunks: t_run_<unit> or t_print_<unit> calls
+ * <name><unit>_0, <name><unit>_1 and so on, each holding up to
+ * CODEGEN_CHUNK_SIZE statements. */
+typedef struct chunked {
+    Writer     *out;
+    const char *name;
+    int        unit;
+    int        statements;
+    int        chunks;
+} Chunked;
+
+static void open_function(const Chunked *function, int chunk) {
+    writer_str(function->out, "\nstatic void ");
+    writer_str(function->out, function->name);
+    writer_int(function->out, function->unit);
+    if (chunk >= 0) {
+        writer_char(function->out, '_');
+        writer_int(function->out, chunk);
+    }
+    writer_str(function->out, "(void) {");
+}
+
+// Start a statement, in a new chunk if the current one is full
+static void statement(Chunked *function) {
+    if (function->statements % CODEGEN_CHUNK_SIZE == 0) {
+        if (function->chunks > 0) {
+            writer_str(function->out, "\n}\n");
+        }
+        open_function(function, function->chunks++);
+    }
+    function->statements++;
+    writer_indent(function->out, 1);
+}
+
+// Close the last chunk and write the function that calls them all
+static void close_function(Chunked *function) {
+    if (function->chunks > 0) {
+        writer_str(function->out, "\n}\n");
+    }
+    open_function(function, -1);
+    for (int chunk = 0; chunk < function->chunks; chunk++) {
+        writer_indent(function->out, 1);
+        writer_str(function->out, function->name);
+        writer_int(function->out, function->unit);
+        writer_char(function->out, '_');
+        writer_int(function->out, chunk);
+        writer_str(function->out, "();");
+    }
+    writer_str(function->out, "\n}\n");
+}
+
+/* The globals and temporaries, which are file-scope variables rather than
+ * locals so that they can be shared between chunks. p_<name> records
+ * whether a global has been printed. */
+static void declarations(const IR *ir, int unit, Writer *out) {
+    writer_char(out, '\n');
+    for (int i = 0; i < ir->globals.size; i++) {
+        writer_str(out, "static ");
+        writer_str(out, c_types[ir->globals.values[i].type]);
+        writer_char(out, ' ');
+        global(ir, i, out);
+        writer_str(out, ";\nstatic char p_");
+        writer_str(out, ir->globals.values[i].name);
+        writer_str(out, ";\n");
+    }
+    for (IRValue v = 0; v < ir->size; v++) {
+        if (ir->ops[v] == IR_LOAD && use_count_IR(ir, v) > 0 &&
+            !is_folded_IR(ir, v)) {
+            writer_str(out, "static ");
+            writer_str(out, c_types[ir->types[v]]);
+            writer_char(out, ' ');
+            temporary(v, unit, out);
+            writer_str(out, ";\n");
+        }
+    }
+}
+
+void codegen_unit(const IR *ir, int unit, Writer *out) {
+    declarations(ir, unit, out);
+    Chunked run = { out, "t_run_", unit, 0, 0 };
+    for (IRValue v = 0; v < ir->size; v++) {
+        switch (ir->ops[v]) {
+            case IR_LOAD:
+                // Unused loads have no effect
+                if (use_count_IR(ir, v) == 0 || is_folded_IR(ir, v)) {
+                    break;
+                }
+                statement(&run);
+                temporary(v, unit, out);
+                writer_bytes(out, " = ", 3);
+                global(ir, ir->args[v], out);
+                writer_char(out, ';');
+                break;
+            case IR_STORE:
+                statement(&run);
+                global(ir, ir->args[v], out);
+                writer_bytes(out, " = ", 3);
+                operand(ir, ir->operands[v], unit, out);
+                writer_char(out, ';');
+                break;
+            default:
+                break;
+        }
+    }
+    close_function(&run);
+    Chunked print = { out, "t_print_", unit, 0, 0 };
+    for (int i = 0; i < ir->globals.size; i++) {
+        const IRGlobal *g = &ir->globals.values[i];
+        statement(&print);
+        writer_str(out, "if (!p_");
+        writer_str(out, g->name);
+        writer_str(out, ") {");
+        writer_indent(out, 2);
+        writer_str(out, "p_");
+        writer_str(out, g->name);
+        writer_str(out, " = 1;");
+        writer_indent(out, 2);
+        writer_str(out, g->type == TYPE_INT ? "t_print_int(\""
+                                            : "t_print_double(\"");
+        writer_str(out, g->name);
+        writer_str(out, "\", ");
+        global(ir, i, out);
+        writer_str(out, ");");
+        writer_indent(out, 1);
+        writer_char(out, '}');
+    }
+    close_function(&print);
+}
+
+void codegen_main(int units, Writer *out) {
+    writer_str(out, "\nint main(void) {");
+    for (int unit = 0; unit < units; unit++) {
+        writer_indent(out, 1);
+        writer_str(out, "t_run_");
+        writer_int(out, unit);
+        writer_str(out, "();");
+    }
+    for (int unit = 0; unit < units; unit++) {
+        writer_indent(out, 1);
+        writer_str(out, "t_print_");
+        writer_int(out, unit);
+        writer_str(out, "();");
+    }
+    writer_indent(out, 1);
+    writer_str(out, "return 0;\n}\n");
+}
@@ -0,0 +1,220 @@
+#include "concurrent_map.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"    // hash_Map()
+
+/* Each table is open addressed with linear probing, and each slot holds a
+ * pointer to an immutable entry. An insert builds its entry first and then
+ * publishes it with a compare-and-swap on an empty slot, so a reader that
+ * sees the pointer also sees the whole entry.
+ *
+ * Tables never move their entries. Once a table reaches its maximum size,
+ * inserts seal the empty slot that ends their probe sequence with MOVED
+ * instead, and carry on in the next, twice as large table. Since a key's
+ * probe sequence always ends at the same slot, two threads inserting the
+ * same key either meet at its entry or both see the slot sealed, and never
+ * add it to two different tables. */
+
+#define CONCURRENT_MAP_LOAD_FACTOR 0.5
+
+typedef struct entry Entry;
+typedef struct table Table;
+
+struct entry {
+    uint64_t   hash;
+    size_t     len;
+    const void *value;
+    char       key[];
+};
+
+struct table {
+    size_t capacity;        // Always a power of two
+    size_t max_size;
+    size_t size;            // Slots claimed so far, updated atomically
+    Table  *next;           // Set at most once, atomically
+    Entry  **slots;
+};
+
+static Entry moved;
+#define MOVED (&moved)
+
+static Table *new_table(size_t capacity) {
+    Table *table = malloc(sizeof(*table));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->capacity = capacity;
+    table->max_size = capacity * CONCURRENT_MAP_LOAD_FACTOR;
+    table->size = 0;
+    table->next = NULL;
+    table->slots = calloc(capacity, sizeof(*table->slots));
+    if (table->slots == NULL) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+static void free_table(Table *table, void (*val_free)(void*)) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        Entry *entry = table->slots[i];
+        if (entry == NULL || entry == MOVED) {
+            continue;
+        }
+        if (val_free != NULL) {
+            val_free((void*)entry->value);
+        }
+        free(entry);
+    }
+    free(table->slots);
+    free(table);
+}
+
+static inline int matches(const Entry *entry, uint64_t h, const void *key,
+                          size_t len) {
+    return entry->hash == h && entry->len == len &&
+           memcmp(entry->key, key, len) == 0;
+}
+
+// The table after 'table', creating it if no other thread has yet
+static Table *next_table(Table *table) {
+    Table *next = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        return next;
+    }
+    Table *new = new_table(table->capacity * 2);
+    if (new == NULL) {
+        return NULL;
+    }
+    if (!__atomic_compare_exchange_n(&table->next, &next, new, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Another thread got there first; next now holds its table
+        free_table(new, NULL);
+    } else {
+        next = new;
+    }
+    return next;
+}
+
+/* Claim the empty slot at 'i' for 'new'. Returns the entry now in the slot,
+ * which is 'new' if it was added, MOVED if the table was full, or whatever
+ * another thread put there in the meantime. */
+static Entry *claim(Table *table, size_t i, Entry *new) {
+    Entry *expected = NULL;
+    Entry *desired = new;
+    if (__atomic_add_fetch(&table->size, 1, __ATOMIC_RELAXED) >
+        table->max_size) {
+        __atomic_sub_fetch(&table->size, 1, __ATOMIC_RELAXED);
+        desired = MOVED;
+    }
+    if (__atomic_compare_exchange_n(&table->slots[i], &expected, desired, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return desired;
+    }
+    if (desired == new) {
+        __atomic_sub_fetch(&table->size, 1, __ATOMIC_RELAXED);
+    }
+    return expected;
+}
+
+static int concurrent_map_insert(const ConcurrentMap *this,
+                                 const void *key,
+                                 size_t len,
+                                 const void *value,
+                                 const void *existing_ptr) {
+    uint64_t h = hash_Map(key, len);
+    Entry *new = malloc(sizeof(*new) + len);
+    if (new == NULL) {
+        return -1;
+    }
+    new->hash = h;
+    new->len = len;
+    new->value = value;
+    memcpy(new->key, key, len);
+    Table *table = this->data;
+    while (table != NULL) {
+        size_t mask = table->capacity - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            Entry *entry = __atomic_load_n(&table->slots[i],
+                                           __ATOMIC_ACQUIRE);
+            if (entry == NULL) {
+                entry = claim(table, i, new);
+                if (entry == new) {
+                    return 0;
+                }
+            }
+            if (entry == MOVED) {
+                break;
+            }
+            if (matches(entry, h, key, len)) {
+                free(new);
+                if (existing_ptr != NULL) {
+                    *(const void**)existing_ptr = entry->value;
+                }
+                return 1;
+            }
+        }
+        table = next_table(table);
+    }
+    free(new);
+    return -1;
+}
+
+static int concurrent_map_get(const ConcurrentMap *this,
+                              const void *key,
+                              size_t len,
+                              const void *value_ptr) {
+    uint64_t h = hash_Map(key, len);
+    for (Table *table = this->data; table != NULL;
+         table = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE)) {
+        size_t mask = table->capacity - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            Entry *entry = __atomic_load_n(&table->slots[i],
+                                           __ATOMIC_ACQUIRE);
+            if (entry == NULL) {
+                return 1;
+            }
+            if (entry == MOVED) {
+                break;
+            }
+            if (matches(entry, h, key, len)) {
+                if (value_ptr == NULL) {
+                    return 1;
+                }
+                *(const void**)value_ptr = entry->value;
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void concurrent_map_free(const ConcurrentMap *this,
+                                void (*val_free)(void*)) {
+    Table *table = this->data;
+    while (table != NULL) {
+        Table *next = table->next;
+        free_table(table, val_free);
+        table = next;
+    }
+    free((void*)this);
+}
+
+const ConcurrentMap *new_ConcurrentMap(size_t capacity) {
+    size_t requested = capacity == 0 ? CONCURRENT_MAP_CAPACITY : capacity;
+    for (capacity = 2; capacity < requested; capacity *= 2);
+    ConcurrentMap *m = malloc(sizeof(*m));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->data = new_table(capacity);
+    if (m->data == NULL) {
+        free(m);
+        return NULL;
+    }
+    m->insert = concurrent_map_insert;
+    m->get    = concurrent_map_get;
+    m->free   = concurrent_map_free;
+    return m;
+}
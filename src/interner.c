@@ -0,0 +1,82 @@
+#include "interner.h"
+#include <stdlib.h>
+#include <string.h> // memcpy()
+#include "map.h"
+#include "vector.h"
+
+struct interner_data {
+    const Arena  *arena;
+    const Map    *symbols;  // Name -> Symbol
+    const Vector *by_id;    // Id -> Symbol
+};
+
+static const Symbol *interner_intern(const Interner *this, const char *str,
+                                     size_t len) {
+    struct interner_data *data = this->data;
+    const Symbol *found = NULL;
+    if (!data->symbols->get(data->symbols, str, len, &found)) {
+        return found;
+    }
+    Symbol *sym = data->arena->alloc(data->arena, sizeof(*sym));
+    char *name = data->arena->alloc(data->arena, len + 1);
+    if (sym == NULL || name == NULL) {
+        return NULL;
+    }
+    memcpy(name, str, len);
+    name[len] = '\0';
+    sym->name = name;
+    sym->len = len;
+    sym->id = data->by_id->size(data->by_id);
+    if (data->symbols->put(data->symbols, str, len, sym, NULL) ||
+        data->by_id->append(data->by_id, sym)) {
+        return NULL;
+    }
+    return sym;
+}
+
+static const Symbol *interner_get(const Interner *this, int id) {
+    struct interner_data *data = this->data;
+    const Symbol *sym = NULL;
+    if (data->by_id->get(data->by_id, id, &sym)) {
+        return NULL;
+    }
+    return sym;
+}
+
+static int interner_size(const Interner *this) {
+    struct interner_data *data = this->data;
+    return data->by_id->size(data->by_id);
+}
+
+static void interner_free(const Interner *this) {
+    // The symbols themselves belong to the arena
+    struct interner_data *data = this->data;
+    data->symbols->free(data->symbols, NULL);
+    data->by_id->free(data->by_id, NULL);
+    free(data);
+    free((void*)this);
+}
+
+const Interner *new_Interner(const Arena *arena) {
+    struct interner_data *data = malloc(sizeof(*data));
+    if (data == NULL) {
+        return NULL;
+    }
+    data->arena = arena;
+    data->symbols = new_Map(INTERNER_CAPACITY, 0);
+    data->by_id = new_Vector(INTERNER_CAPACITY);
+    Interner *interner = malloc(sizeof(*interner));
+    if (data->symbols == NULL || data->by_id == NULL || interner == NULL) {
+        if (data->symbols) data->symbols->free(data->symbols, NULL);
+        if (data->by_id) data->by_id->free(data->by_id, NULL);
+        free(data);
+        free(interner);
+        return NULL;
+    }
+    interner->data   = data;
+    interner->intern = interner_intern;
+    interner->get    = interner_get;
+    interner->size   = interner_size;
+    interner->free   = interner_free;
+    return interner;
+}
@@ -0,0 +1,306 @@
+#include "ir.h"
+#include <stdlib.h>
+#include <string.h> // strdup()
+#include "ast_walk.h"
+
+static const char *const op_names[IR_OP_COUNT] = {
+    [IR_INT]    = "int",
+    [IR_DOUBLE] = "double",
+    [IR_LOAD]   = "load",
+    [IR_STORE]  = "store",
+    [IR_NOP]    = "nop"
+};
+
+static int reserve(IR *ir, uint32_t size) {
+    if (size <= ir->capacity) {
+        return 0;
+    }
+    uint32_t capacity = ir->capacity > 0 ? ir->capacity : IR_CAPACITY;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    uint8_t *ops = realloc(ir->ops, capacity * sizeof(*ops));
+    if (ops == NULL) {
+        return 1;
+    }
+    ir->ops = ops;
+    uint8_t *types = realloc(ir->types, capacity * sizeof(*types));
+    if (types == NULL) {
+        return 1;
+    }
+    ir->types = types;
+    uint32_t *args = realloc(ir->args, capacity * sizeof(*args));
+    if (args == NULL) {
+        return 1;
+    }
+    ir->args = args;
+    IRValue *operands = realloc(ir->operands, capacity * sizeof(*operands));
+    if (operands == NULL) {
+        return 1;
+    }
+    ir->operands = operands;
+    ir->capacity = capacity;
+    return 0;
+}
+
+// Append a value to the last block; returns IR_NONE if out of memory
+static IRValue add_value(IR *ir, IROp op, Type type, uint32_t arg,
+                         IRValue operand) {
+    if (reserve(ir, ir->size + 1)) {
+        return IR_NONE;
+    }
+    IRValue value = ir->size++;
+    ir->ops[value] = op;
+    ir->types[value] = type;
+    ir->args[value] = arg;
+    ir->operands[value] = operand;
+    ir->blocks.values[ir->blocks.size - 1].end = ir->size;
+    return value;
+}
+
+typedef struct building {
+    IR       *ir;
+    uint32_t *globals;      // Symbol id -> global
+    int      status;        // Nonzero once out of memory
+} Building;
+
+static IRValue build_value(Building *building, const ASTNode *node) {
+    IR *ir = building->ir;
+    uint32_t global;
+    switch (node->kind) {
+        case AST_INT:
+            return add_value(ir, IR_INT, TYPE_INT,
+                             (uint32_t)node->data.integer.val, IR_NONE);
+        case AST_DOUBLE:
+            if (append_IRConstants(&ir->constants, node->data.real.val)) {
+                return IR_NONE;
+            }
+            return add_value(ir, IR_DOUBLE, TYPE_DOUBLE,
+                             ir->constants.size - 1, IR_NONE);
+        case AST_VARIABLE:
+            global = building->globals[node->data.variable.name->id];
+            break;
+        case AST_ASSIGNMENT:
+            // Its target's new value
+            global = building->globals[
+                node->data.assignment.lhs->data.variable.name->id];
+            break;
+        default:
+            return IR_NONE;
+    }
+    return add_value(ir, IR_LOAD, ir->globals.values[global].type, global,
+                     IR_NONE);
+}
+
+/* Statements are built as the walk leaves them, so an assignment's value is
+ * ready by the time its store is added. */
+static void build_leave(ASTWalkFrame *frame, ASTWalkFrame *parent,
+                        void *ctx) {
+    Building *building = ctx;
+    IR *ir = building->ir;
+    const ASTNode *node = frame->node;
+    if (node->kind == AST_ASSIGNMENT) {
+        IRValue value = build_value(building, node->data.assignment.rhs);
+        uint32_t global = building->globals[
+            node->data.assignment.lhs->data.variable.name->id];
+        if (value == IR_NONE ||
+            add_value(ir, IR_STORE, ir->types[value], global, value)
+            == IR_NONE) {
+            building->status = 1;
+        }
+    } else if (parent != NULL && parent->node->kind == AST_PROGRAM &&
+               node->kind != AST_LEAF) {
+        // An expression statement; its value is computed but never used
+        if (build_value(building, node) == IR_NONE) {
+            building->status = 1;
+        }
+    }
+}
+
+int build_IR(IR *ir, const ASTNode *root, const TypeChecker *checker) {
+    // A checked file's declarations are exactly its globals
+    const TypeDeclarations *declarations = &checker->declarations;
+    IRBlock entry = { 0, 0 };
+    Building building = {
+        ir, malloc((checker->types_size + 1) * sizeof(uint32_t)), 0
+    };
+    if (building.globals == NULL || append_IRBlocks(&ir->blocks, entry)) {
+        free(building.globals);
+        return 1;
+    }
+    for (int i = 0; i < declarations->size; i++) {
+        const TypeDeclaration *declaration = &declarations->values[i];
+        IRGlobal global = {
+            strdup(declaration->target->data.variable.name->name),
+            checker->types[declaration->id]
+        };
+        if (global.name == NULL || append_IRGlobals(&ir->globals, global)) {
+            free(global.name);
+            free(building.globals);
+            return 1;
+        }
+        building.globals[declaration->id] = i;
+    }
+    if (walk_ASTNode(root, NULL, build_leave, &building, NULL)) {
+        building.status = 1;
+    }
+    free(building.globals);
+    return building.status || index_IR(ir);
+}
+
+int index_IR(IR *ir) {
+    uint32_t *offsets = realloc(ir->use_offsets,
+                                (ir->size + 1) * sizeof(*offsets));
+    if (offsets == NULL) {
+        return 1;
+    }
+    ir->use_offsets = offsets;
+    // Count the uses of each value, then turn the counts into offsets
+    memset(offsets, 0, (ir->size + 1) * sizeof(*offsets));
+    for (IRValue value = 0; value < ir->size; value++) {
+        if (ir->operands[value] != IR_NONE) {
+            offsets[ir->operands[value] + 1]++;
+        }
+    }
+    for (IRValue value = 0; value < ir->size; value++) {
+        offsets[value + 1] += offsets[value];
+    }
+    IRValue *uses = realloc(ir->uses,
+                            (offsets[ir->size] + 1) * sizeof(*uses));
+    if (uses == NULL) {
+        return 1;
+    }
+    ir->uses = uses;
+    // Users come in program order, so each value's uses end up sorted
+    for (IRValue value = 0; value < ir->size; value++) {
+        IRValue operand = ir->operands[value];
+        if (operand != IR_NONE) {
+            uses[offsets[operand]++] = value;
+        }
+    }
+    // Filling advanced every offset to the next value's; shift them back
+    for (IRValue value = ir->size; value > 0; value--) {
+        offsets[value] = offsets[value - 1];
+    }
+    offsets[0] = 0;
+    return 0;
+}
+
+int compact_IR(IR *ir) {
+    IRValue *renumber = malloc((ir->size + 1) * sizeof(*renumber));
+    if (renumber == NULL) {
+        return 1;
+    }
+    IRValue size = 0;
+    for (int b = 0; b < ir->blocks.size; b++) {
+        IRBlock *block = &ir->blocks.values[b];
+        IRValue first = size;
+        for (IRValue value = block->first; value < block->end; value++) {
+            if (ir->ops[value] == IR_NOP) {
+                renumber[value] = IR_NONE;
+                continue;
+            }
+            IRValue operand = ir->operands[value];
+            renumber[value] = size;
+            ir->ops[size] = ir->ops[value];
+            ir->types[size] = ir->types[value];
+            ir->args[size] = ir->args[value];
+            ir->operands[size] = operand == IR_NONE ? IR_NONE
+                                                    : renumber[operand];
+            size++;
+        }
+        block->first = first;
+        block->end = size;
+    }
+    ir->size = size;
+    free(renumber);
+    return index_IR(ir);
+}
+
+static void dump_value(IRValue value, Writer *out) {
+    writer_char(out, '%');
+    writer_int(out, value);
+}
+
+void dump_IR(const IR *ir, const char *filename, Writer *out) {
+    writer_str(out, "; ");
+    writer_str(out, filename);
+    writer_char(out, '\n');
+    for (int i = 0; i < ir->globals.size; i++) {
+        writer_str(out, "global ");
+        writer_str(out, ir->globals.values[i].name);
+        writer_str(out, ": ");
+        writer_str(out, name_Type(ir->globals.values[i].type));
+        writer_char(out, '\n');
+    }
+    for (int b = 0; b < ir->blocks.size; b++) {
+        const IRBlock *block = &ir->blocks.values[b];
+        writer_str(out, "block ");
+        writer_int(out, b);
+        writer_str(out, ":\n");
+        for (IRValue value = block->first; value < block->end; value++) {
+            IROp op = ir->ops[value];
+            writer_str(out, "    ");
+            if (op != IR_STORE && op != IR_NOP) {
+                dump_value(value, out);
+                writer_str(out, " = ");
+            }
+            writer_str(out, op_names[op]);
+            writer_char(out, ' ');
+            writer_str(out, name_Type(ir->types[value]));
+            switch (op) {
+                case IR_INT:
+                    writer_char(out, ' ');
+                    writer_int(out, (int32_t)ir->args[value]);
+                    break;
+                case IR_DOUBLE:
+                    writer_char(out, ' ');
+                    writer_double(out,
+                                  ir->constants.values[ir->args[value]]);
+                    break;
+                case IR_LOAD:
+                case IR_STORE:
+                    writer_char(out, ' ');
+                    writer_str(out, ir->globals.values[ir->args[value]].name);
+                    break;
+                default:
+                    break;
+            }
+            if (ir->operands[value] != IR_NONE) {
+                writer_str(out, ", ");
+                dump_value(ir->operands[value], out);
+            }
+            writer_char(out, '\n');
+        }
+    }
+}
+
+IR *new_IR(void) {
+    IR *ir = calloc(1, sizeof(*ir));
+    if (ir == NULL) {
+        return NULL;
+    }
+    if (init_IRBlocks(&ir->blocks, 0) ||
+        init_IRConstants(&ir->constants, 0) ||
+        init_IRGlobals(&ir->globals, 0)) {
+        free_IR(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+void free_IR(IR *ir) {
+    for (int i = 0; i < ir->globals.size; i++) {
+        free(ir->globals.values[i].name);
+    }
+    free(ir->ops);
+    free(ir->types);
+    free(ir->args);
+    free(ir->operands);
+    free_IRBlocks(&ir->blocks);
+    free_IRConstants(&ir->constants);
+    free_IRGlobals(&ir->globals);
+    free(ir->use_offsets);
+    free(ir->uses);
+    free(ir);
+}
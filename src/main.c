@@ -1,10 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> // strcmp(), strcpy()
 #include <getopt.h> // getopt()
 #include <stdarg.h> // va_list, va_start(), va_end()
+#include <errno.h>
+#include <unistd.h> // fork(), execlp(), mkstemps()
+#include <sys/wait.h>
 #include "Tlang_parser.h"
 #include "Tlang_scanner.h"
 #include "ast.h"
+#include "ast_flat.h"
+#include "ast_bin.h"
+#include "ast_walk.h"
+#include "arena.h"
+#include "pool.h"
+#include "source.h"
+#include "writer.h"
+#include "typechecker.h"
+#include "concurrent_map.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "codegen.h"
+#include "asmgen.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "time_report.h"
 
 #define NAME    "tcc"
 #define VERSION "0.1.0"
@@ -12,6 +32,55 @@
 #define WHITE   "\033[0m"
 #define ERROR   NAME ": " RED "error: " WHITE
 
+#define TRACE_BUFFER_SIZE (64 * 1024)
+#define TEMP_C_FILE       "/tmp/tccXXXXXX.c"
+#define TEMP_ASM_FILE     "/tmp/tccXXXXXX.s"
+
+// What --emit asks for
+typedef enum emit {
+    EMIT_EXE,       // Executable in the output file, built by the C compiler
+    EMIT_C,         // C source (see codegen.h) in the output file
+    EMIT_ASM,       // x86-64 assembly (see asmgen.h) in the output file
+    EMIT_JSON,      // JSON AST on stdout
+    EMIT_IR,        // IR (see ir.h) as text on stdout
+    EMIT_AST_BIN,   // Binary AST (see ast_bin.h) in the output file
+    EMIT_RUN        // Nothing; run the program in the VM (see vm.h)
+} Emit;
+
+/* One input file. When files are compiled in parallel, each file's output,
+ * diagnostics and token trace are collected in memory and written out in
+ * input order once the file is done. */
+typedef struct compile_job {
+    const char *filename;
+    Source     *input;
+    FILE       *out, *err, *trace, *code;
+    char       *out_buf, *err_buf, *trace_buf, *code_buf;
+    size_t     out_size, err_size, trace_size, code_size;
+    Bytecode   *bytecode;
+    TimeReport *report;     // NULL without --time-report
+    GlobalSymbols globals;  // Published by the file's typechecker
+    int        status;
+} CompileJob;
+
+typedef struct compilation {
+    CompileJob          *jobs;
+    FILE                *trace;
+    FILE                *output;    // Only opened for output file kinds
+    const ConcurrentMap *globals;   // GlobalNames, shared by the checkers
+    Bytecode            *program;   // Only for EMIT_RUN
+    Emit                emit;
+    int                 optimize;   // -O level
+    int                 native;     // Code is generated by asmgen.h
+    int                 flat_ast;
+    int                 compact;
+    int                 buffered;
+} Compilation;
+
+static int is_ast_bin(const char *filename);
+static void compile_file(void *ctx, int i);
+static int run_cc(const char *source_filename, const char *language,
+                  const char *out_filename);
+static void finish_file(void *ctx, int i);
 void print_usage(char *argv0);
 int asprintf(char **strp, const char *fmt, ...);
 void *malloc_check(size_t size);
@@ -20,47 +89,158 @@ char *strdup_check(const char *s);
 static struct option options[] = {
     {"help",    no_argument, 0, 'h'},
     {"version", no_argument, 0, 'v'},
+    {"flat-ast", no_argument, 0, 'F'},
+    {"compact", no_argument, 0, 'C'},
+    {"emit", required_argument, 0, 'E'},
+    {"run", no_argument, 0, 'R'},
+    {"native", no_argument, 0, 'N'},
+    {"trace-tokens", optional_argument, 0, 'T'},
+    {"time-report", optional_argument, 0, 'P'},
     {0, 0, 0, 0}
 };
 
 static char* options_help[] = {
     "--help        Display this information.",
     "--version     Display compiler version information.",
-    "-o <file>     Place the output into <file>."
+    "--flat-ast    Build the AST in the flat, index-based backend.",
+    "--compact     Dump the AST as JSON without any whitespace.",
+    "--emit=<kind> Output 'exe' (default, an executable built with $CC or\n"
+    "                cc), 'c' (the C source of that), 'asm' (x86-64\n"
+    "                assembly), 'json' (the AST, to stdout), 'ir' (the IR,\n"
+    "                to stdout) or 'ast-bin' (a binary AST; needs a single\n"
+    "                input file). All but json and ir go to the -o file.\n"
+    "                Inputs ending in .astb are binary ASTs, which can only\n"
+    "                be dumped with --emit=json.",
+    "--native      Build the executable from x86-64 assembly rather than\n"
+    "                from C.",
+    "--run         Run the program in the bytecode VM instead of building\n"
+    "                anything.",
+    "--trace-tokens[=<file>]\n"
+    "                Write every token to <file> (default: stderr).",
+    "--time-report[=json]\n"
+    "                Write the time each phase took, per file and in total,\n"
+    "                with token and node counts and memory use, to stderr.",
+    "-o <file>     Place the output into <file>.",
+    "-O[<level>]   Optimize at <level>, 0 (default, none) or 1; -O alone\n"
+    "                means -O1.",
+    "-j <jobs>     Compile up to <jobs> input files in parallel."
 };
 
 int main(int argc, char *argv[]) {
-    int opt, opt_index, file_count, i, status = 0;
-    char *out_filename = "a.out", *err;
-    FILE **inputs, *output;
-    yyscan_t scanner;
-    YY_BUFFER_STATE state;
+    int opt, opt_index, file_count, i, status = 0, flat_ast = 0, compact = 0;
+    int trace_tokens = 0, threads = 1, optimize = 0, native = 0;
+    int time_report = 0, time_report_json = 0;
+    TimeReport program_report, *program_timing = NULL, *reports = NULL;
+    Emit emit = EMIT_EXE;
+    char *out_filename = "a.out", *trace_filename = NULL, *err;
+    char source_filename[] = TEMP_C_FILE, *output_filename = NULL;
+    Source **inputs;
+    FILE *output = NULL, *trace = NULL;
+    CompileJob *jobs;
 
     opterr = 0;
-    while ((opt = getopt_long(argc, argv, "o:h", options, &opt_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "o:hj:O::", options, &opt_index))
+           != -1) {
         switch (opt) {
             case 'o':
                 out_filename = strdup_check(optarg);
                 break;
+            case 'j':
+                threads = strtol(optarg, &err, 10);
+                if (*optarg == '\0' || *err != '\0' || threads < 1) {
+                    fprintf(stderr, ERROR "invalid job count: '%s'\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'O':
+                optimize = optarg ? strtol(optarg, &err, 10) : 1;
+                if (optarg && (*optarg == '\0' || *err != '\0' ||
+                               optimize < 0 ||
+                               optimize > OPTIMIZER_MAX_LEVEL)) {
+                    fprintf(stderr, ERROR "invalid optimization level: "
+                            "'%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'h':
                 print_usage(argv[0]);
                 exit(EXIT_SUCCESS);
             case 'v':
                 fprintf(stdout, "%s version %s\n", NAME, VERSION);
                 exit(EXIT_SUCCESS);
+            case 'F':
+                flat_ast = 1;
+                break;
+            case 'C':
+                compact = 1;
+                break;
+            case 'E':
+                if (strcmp(optarg, "exe") == 0) {
+                    emit = EMIT_EXE;
+                } else if (strcmp(optarg, "c") == 0) {
+                    emit = EMIT_C;
+                } else if (strcmp(optarg, "asm") == 0) {
+                    emit = EMIT_ASM;
+                } else if (strcmp(optarg, "json") == 0) {
+                    emit = EMIT_JSON;
+                } else if (strcmp(optarg, "ir") == 0) {
+                    emit = EMIT_IR;
+                } else if (strcmp(optarg, "ast-bin") == 0) {
+                    emit = EMIT_AST_BIN;
+                } else {
+                    fprintf(stderr, ERROR "unknown output kind: '%s'\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'R':
+                emit = EMIT_RUN;
+                break;
+            case 'N':
+                native = 1;
+                break;
+            case 'T':
+                trace_filename = optarg ? strdup_check(optarg) : NULL;
+                trace_tokens = 1;
+                break;
+            case 'P':
+                if (optarg != NULL && strcmp(optarg, "json") != 0) {
+                    fprintf(stderr, ERROR "unknown time report format: "
+                            "'%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                time_report = 1;
+                time_report_json = optarg != NULL;
+                break;
             default:
                 fprintf(stderr, ERROR "unknown argument: '-%c'\n", optopt);
                 exit(EXIT_FAILURE);
         }
     }
+    if (time_report) {
+        program_timing = &program_report;
+        start_TimeReport(program_timing);
+    }
     file_count = argc - optind;
     if (file_count == 0) {
         fprintf(stderr, ERROR "no input files\n");
         exit(EXIT_FAILURE);
     }
-    inputs = malloc_check(sizeof(FILE*) * file_count);
+    if (emit == EMIT_AST_BIN && file_count > 1) {
+        fprintf(stderr, ERROR "--emit=ast-bin takes a single input file\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < file_count; i++) {
+        if (emit != EMIT_JSON && is_ast_bin(argv[optind + i])) {
+            fprintf(stderr, ERROR "binary AST input '%s' needs "
+                    "--emit=json\n", argv[optind + i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    inputs = malloc_check(sizeof(Source*) * file_count);
     for(i = 0; i < file_count; i++) {
-        inputs[i] = fopen(argv[optind + i], "r");
+        inputs[i] = new_Source(argv[optind + i]);
         if (inputs[i] == NULL) {
             asprintf(&err,
                 ERROR "unable to open file '%s'",
@@ -74,42 +254,505 @@ int main(int argc, char *argv[]) {
     if (status) {
         exit(EXIT_FAILURE);
     }
+    if (trace_tokens) {
+        trace = trace_filename ? fopen(trace_filename, "w") : stderr;
+        if (trace == NULL) {
+            asprintf(&err, ERROR "unable to open file '%s'", trace_filename);
+            perror(err);
+            free(err);
+            exit(EXIT_FAILURE);
+        }
+        // Fully buffer the trace, it is written a line at a time
+        setvbuf(trace, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    }
+    jobs = calloc(file_count, sizeof(*jobs));
+    if (jobs == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    if (time_report) {
+        reports = calloc(file_count, sizeof(*reports));
+        if (reports == NULL) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
     for (i = 0; i < file_count; i++) {
-        /* Initialize Flex and Bison */
-        if (yylex_init(&scanner)) {
-            fprintf(stderr, ERROR "could not initialize Flex scanner.\n");
+        jobs[i].filename = argv[optind + i];
+        jobs[i].input    = inputs[i];
+        jobs[i].report   = time_report ? &reports[i] : NULL;
+    }
+    native = emit == EMIT_ASM || (emit == EMIT_EXE && native);
+    // An executable is compiled from C or assembly in a temporary file
+    if (emit == EMIT_EXE) {
+        if (native) {
+            strcpy(source_filename, TEMP_ASM_FILE);
+        }
+        int fd = mkstemps(source_filename, 2);
+        output = fd < 0 ? NULL : fdopen(fd, "w");
+        output_filename = source_filename;
+    } else if (emit == EMIT_C || emit == EMIT_ASM || emit == EMIT_AST_BIN) {
+        output = fopen(out_filename, emit == EMIT_AST_BIN ? "wb" : "w");
+        output_filename = out_filename;
+    }
+    if (output_filename != NULL && output == NULL) {
+        asprintf(&err, ERROR "unable to open file '%s'", output_filename);
+        perror(err);
+        free(err);
+        exit(EXIT_FAILURE);
+    }
+    /* The files' code is written by finish_file(), in input order, between
+     * the prelude and main(). */
+    Writer *code = NULL;
+    if (emit == EMIT_EXE || emit == EMIT_C || emit == EMIT_ASM) {
+        code = new_Writer(output, CODEGEN_TAB_WIDTH);
+        if (code == NULL) {
+            perror(ERROR "unable to allocate memory");
             exit(EXIT_FAILURE);
         }
-        state = yy_create_buffer(inputs[i], YY_BUF_SIZE, scanner);
-        yy_switch_to_buffer(state, scanner);
-        const ASTNode *root;
-        if (yyparse(&root, argv[optind + i], scanner)) {
-            status = 1;
+        if (native) {
+            asmgen_prelude(code);
         } else {
-            ASTNodeVTable *vtable = root->vtable;
-		    vtable->json(root, 0, stdout);
-		    fprintf(stdout, "\n");
-		    vtable->free(root);
-	    }
-        yy_delete_buffer(state, scanner);
-        yylex_destroy(scanner);
-        fclose(inputs[i]);
+            codegen_prelude(code);
+        }
+        flush_Writer(code);
+    }
+    const ConcurrentMap *globals = new_ConcurrentMap(0);
+    if (globals == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
     }
+    // Files are linked into the program as they finish, in input order
+    Bytecode *program = NULL;
+    if (emit == EMIT_RUN && (program = new_Bytecode()) == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    Compilation compilation = {
+        jobs, trace, output, globals, program, emit, optimize, native,
+        flat_ast, compact, threads > 1
+    };
+    parallel_for(threads, file_count, compile_file, finish_file, &compilation);
+    for (i = 0; i < file_count; i++) {
+        status |= jobs[i].status;
+        free_GlobalSymbols(&jobs[i].globals);
+    }
+    globals->free(globals, free);
+    if (code != NULL) {
+        if (native) {
+            asmgen_main(file_count, code);
+        } else {
+            codegen_main(file_count, code);
+        }
+        if (free_Writer(code)) {
+            asprintf(&err, ERROR "unable to write file '%s'", output_filename);
+            perror(err);
+            free(err);
+            status = 1;
+        }
+    }
+    free(jobs);
     free(inputs);
+    if (trace != NULL && trace != stderr) {
+        fclose(trace);
+    }
+    if (output != NULL) {
+        if (fclose(output) != 0) {
+            asprintf(&err, ERROR "unable to write file '%s'", output_filename);
+            perror(err);
+            free(err);
+            status = 1;
+        }
+        if (status) {
+            remove(output_filename);
+        }
+    }
     if (status) {
         exit(EXIT_FAILURE);
     }
-    output = fopen(out_filename, "w");
-    if (output == NULL) {
-        asprintf(&err, ERROR "unable to open file '%s'", out_filename);
-        perror(err);
-        free(err);
+    if (program != NULL) {
+        if (seal_Bytecode(program)) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        fflush(stdout);
+        lap_TimeReport(program_timing, PHASE_NONE);
+        if (run_VM(program, stdout)) {
+            perror(ERROR "unable to run the program");
+            exit(EXIT_FAILURE);
+        }
+        lap_TimeReport(program_timing, PHASE_RUN);
+        free_Bytecode(program);
+    }
+    if (emit == EMIT_EXE) {
+        lap_TimeReport(program_timing, PHASE_NONE);
+        status = run_cc(source_filename, native ? "assembler" : "c",
+                        out_filename);
+        lap_TimeReport(program_timing, PHASE_CC);
+        remove(source_filename);
+        if (status) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (time_report) {
+        fflush(stdout);
+        Writer *report = new_Writer(stderr, compact ? 0 : JSON_TAB_WIDTH);
+        if (report == NULL) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        write_TimeReport(reports, argv + optind, file_count, program_timing,
+                         report, time_report_json);
+        free_Writer(report);
+        free(reports);
+    }
+    return 0;
+}
+
+/* Build an executable from a C or assembly file, as 'language' tells the
+ * system C compiler, $CC or cc. Returns nonzero, after reporting why, if no
+ * executable was produced. */
+static int run_cc(const char *source_filename, const char *language,
+                  const char *out_filename) {
+    const char *cc = getenv("CC");
+    if (cc == NULL || *cc == '\0') {
+        cc = "cc";
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror(ERROR "unable to run the C compiler");
+        return 1;
+    }
+    if (pid == 0) {
+        execlp(cc, cc, "-x", language, "-o", out_filename, source_filename,
+               (char*)NULL);
+        fprintf(stderr, ERROR "unable to run '%s': %s\n", cc,
+                strerror(errno));
+        _exit(EXIT_FAILURE);
+    }
+    int wstatus;
+    while (waitpid(pid, &wstatus, 0) < 0) {
+        if (errno != EINTR) {
+            perror(ERROR "unable to run the C compiler");
+            return 1;
+        }
+    }
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+        fprintf(stderr, ERROR "the C compiler '%s' failed\n", cc);
+        return 1;
+    }
+    return 0;
+}
+
+static FILE *open_memstream_check(char **buf, size_t *size) {
+    FILE *stream = open_memstream(buf, size);
+    if (stream == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    return stream;
+}
+
+/* Returns the checker, or NULL if the file has type errors. Conflicts
+ * between the globals of different files are found later, by
+ * finish_file(). */
+static TypeChecker *check_types(const Compilation *compilation,
+                                CompileJob *job, int i,
+                                const ASTBuilder *builder,
+                                const ASTNode *root) {
+    TypeChecker *checker = new_TypeChecker(builder->interner, job->filename,
+                                           job->err, compilation->globals, i,
+                                           &job->globals);
+    if (checker == NULL) {
+        perror(ERROR "unable to allocate memory");
         exit(EXIT_FAILURE);
     }
-    fclose(output);
+    int errors = check_TypeChecker(checker, root);
+    if (errors < 0) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    lap_TimeReport(job->report, PHASE_CHECK);
+    if (errors > 0) {
+        free_TypeChecker(checker);
+        return NULL;
+    }
+    return checker;
+}
+
+// Generate the file's C or assembly code into the job's code buffer
+static void generate_code(const Compilation *compilation, CompileJob *job,
+                          int unit, const IR *ir) {
+    job->code = open_memstream_check(&job->code_buf, &job->code_size);
+    Writer *writer = new_Writer(job->code, CODEGEN_TAB_WIDTH);
+    if (writer == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    if (!compilation->native) {
+        codegen_unit(ir, unit, writer);
+    } else if (asmgen_unit(ir, unit, writer)) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    if (free_Writer(writer) || fclose(job->code) != 0) {
+        perror(ERROR "unable to write output");
+        job->status = 1;
+    }
+}
+
+/* Build a checked file's IR and pass it to the backend. writer is only set
+ * for EMIT_IR. */
+static void compile_ir(const Compilation *compilation, CompileJob *job,
+                       int unit, const ASTNode *root,
+                       const TypeChecker *checker, Writer *writer) {
+    IR *ir = new_IR();
+    if (ir == NULL || build_IR(ir, root, checker) ||
+        optimize_IR(ir, compilation->optimize)) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    lap_TimeReport(job->report, PHASE_IR);
+    if (compilation->emit == EMIT_IR) {
+        dump_IR(ir, job->filename, writer);
+    } else if (compilation->emit == EMIT_RUN) {
+        if ((job->bytecode = new_Bytecode()) == NULL ||
+            lower_Bytecode(job->bytecode, ir)) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        generate_code(compilation, job, unit, ir);
+    }
+    free_IR(ir);
+}
+
+static int count_node(UNUSED ASTWalkFrame *frame,
+                      UNUSED ASTWalkFrame *parent, void *ctx) {
+    TimeReport *report = ctx;
+    report->nodes++;
     return 0;
 }
 
+static void count_nodes(TimeReport *report, const ASTNode *root) {
+    if (walk_ASTNode(root, count_node, NULL, report, NULL)) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Whether the input is a binary AST rather than T source
+static int is_ast_bin(const char *filename) {
+    size_t len = strlen(filename), suffix = strlen(AST_BIN_SUFFIX);
+    return len >= suffix &&
+           strcmp(filename + len - suffix, AST_BIN_SUFFIX) == 0;
+}
+
+// Dump a binary AST input as JSON, the only output it supports
+static void dump_ast_bin(const Compilation *compilation, CompileJob *job) {
+    ASTBin *bin = load_ASTBin(job->filename);
+    lap_TimeReport(job->report, PHASE_PARSE);
+    if (bin == NULL) {
+        fprintf(job->err, ERROR "unable to load binary AST '%s': %s\n",
+                job->filename, strerror(errno));
+        job->status = 1;
+        return;
+    }
+    Writer *writer = new_Writer(job->out,
+                                compilation->compact ? 0 : JSON_TAB_WIDTH);
+    if (writer == NULL || json_ASTFlat(&bin->flat, bin->root, 0, writer)) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    writer_char(writer, '\n');
+    if (free_Writer(writer)) {
+        perror(ERROR "unable to write output");
+        job->status = 1;
+    }
+    lap_TimeReport(job->report, PHASE_EMIT);
+    free_ASTBin(bin);
+}
+
+// Scan, parse, check and dump a T source file
+static void compile_source(const Compilation *compilation, CompileJob *job,
+                           int i) {
+    yyscan_t scanner;
+    YY_BUFFER_STATE state;
+
+    /* Initialize Flex and Bison */
+    ScannerState *scanner_state = new_ScannerState(job->trace, job->err);
+    if (scanner_state == NULL ||
+        yylex_init_extra(scanner_state, &scanner)) {
+        fprintf(stderr, ERROR "could not initialize Flex scanner.\n");
+        exit(EXIT_FAILURE);
+    }
+    /* Every node, location and identifier of this file lives in the
+     * arena, so tearing down the AST is a single arena release. */
+    ASTBuilder builder = { new_Arena(0), NULL, NULL };
+    if (builder.arena == NULL ||
+        (builder.interner = new_Interner(builder.arena)) == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    // The binary AST is written straight from the flat backend's arrays
+    if ((compilation->flat_ast || compilation->emit == EMIT_AST_BIN) &&
+        (builder.flat = new_ASTFlat()) == NULL) {
+        perror(ERROR "unable to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    // Scan the file contents in place, without copying them into flex
+    state = yy_scan_buffer(job->input->data, job->input->size + 2, scanner);
+    if (state == NULL) {
+        fprintf(stderr, ERROR "could not initialize Flex buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Only the text dumps go through a writer; its buffer is large
+    Writer *writer = NULL;
+    if (compilation->emit == EMIT_JSON || compilation->emit == EMIT_IR) {
+        writer = new_Writer(job->out,
+                            compilation->compact ? 0 : JSON_TAB_WIDTH);
+        if (writer == NULL) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    const ASTNode *root;
+    TypeChecker *checker = NULL;
+    int parse_status = yyparse(&root, job->filename, &builder, scanner);
+    lap_TimeReport(job->report, PHASE_PARSE);
+    if (job->report != NULL) {
+        job->report->tokens = tokens_ScannerState(scanner_state);
+        job->report->arena_bytes = builder.arena->used(builder.arena);
+        if (parse_status == 0) {
+            count_nodes(job->report, root);
+        }
+        lap_TimeReport(job->report, PHASE_NONE);
+    }
+    if (parse_status) {
+        job->status = 1;
+    } else if ((checker = check_types(compilation, job, i, &builder, root))
+               == NULL) {
+        job->status = 1;
+        free_ASTNode(root);
+    } else if (compilation->emit != EMIT_JSON &&
+               compilation->emit != EMIT_AST_BIN) {
+        compile_ir(compilation, job, i, root, checker, writer);
+        free_ASTNode(root);
+    } else if (builder.flat) {
+        /* The pointer tree was only needed while parsing; release it
+         * before working on the flat copy. */
+        ASTRef ref = root->ref;
+        free_ASTNode(root);
+        builder.interner->free(builder.interner);
+        builder.arena->free(builder.arena);
+        builder.arena = NULL;
+        if (compilation->emit == EMIT_AST_BIN) {
+            if (write_ASTBin(builder.flat, ref, compilation->output)) {
+                perror(ERROR "unable to write output");
+                job->status = 1;
+            }
+        } else {
+            if (json_ASTFlat(builder.flat, ref, 0, writer)) {
+                perror(ERROR "unable to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            writer_char(writer, '\n');
+        }
+    } else {
+        if (json_ASTNode(root, 0, writer)) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        writer_char(writer, '\n');
+        free_ASTNode(root);
+    }
+    if (writer != NULL && free_Writer(writer)) {
+        perror(ERROR "unable to write output");
+        job->status = 1;
+    }
+    lap_TimeReport(job->report, PHASE_EMIT);
+    if (checker != NULL) {
+        free_TypeChecker(checker);
+    }
+    if (builder.arena) {
+        builder.interner->free(builder.interner);
+        builder.arena->free(builder.arena);
+    }
+    if (builder.flat) {
+        free_ASTFlat(builder.flat);
+    }
+    yy_delete_buffer(state, scanner);
+    yylex_destroy(scanner);
+    free_ScannerState(scanner_state);
+}
+
+/* Compile or dump one input file. Runs on a worker thread when compiling in
+ * parallel, so it only touches its own job. */
+static void compile_file(void *ctx, int i) {
+    Compilation *compilation = ctx;
+    CompileJob *job = &compilation->jobs[i];
+
+    start_TimeReport(job->report);
+    if (compilation->buffered) {
+        job->out = open_memstream_check(&job->out_buf, &job->out_size);
+        job->err = open_memstream_check(&job->err_buf, &job->err_size);
+        job->trace = compilation->trace == NULL ? NULL :
+            open_memstream_check(&job->trace_buf, &job->trace_size);
+    } else {
+        job->out   = stdout;
+        job->err   = stderr;
+        job->trace = compilation->trace;
+    }
+    if (is_ast_bin(job->filename)) {
+        dump_ast_bin(compilation, job);
+    } else {
+        compile_source(compilation, job, i);
+    }
+    free_Source(job->input);
+    if (compilation->buffered) {
+        fclose(job->out);
+        fclose(job->err);
+        if (job->trace != NULL) {
+            fclose(job->trace);
+        }
+    }
+    lap_TimeReport(job->report, PHASE_TEARDOWN);
+}
+
+/* Write out whatever a job collected in memory, in input order. The
+ * file's globals are checked against earlier files here too, so conflicts
+ * are reported the same way however the files were scheduled. */
+static void finish_file(void *ctx, int i) {
+    Compilation *compilation = ctx;
+    CompileJob *job = &compilation->jobs[i];
+    if (job->code_buf != NULL) {
+        fwrite(job->code_buf, 1, job->code_size, compilation->output);
+        free(job->code_buf);
+    }
+    if (job->bytecode != NULL) {
+        if (link_Bytecode(compilation->program, job->bytecode)) {
+            perror(ERROR "unable to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        free_Bytecode(job->bytecode);
+    }
+    if (compilation->buffered) {
+        fwrite(job->err_buf, 1, job->err_size, stderr);
+        fwrite(job->out_buf, 1, job->out_size, stdout);
+        if (job->trace_buf != NULL) {
+            fwrite(job->trace_buf, 1, job->trace_size, compilation->trace);
+        }
+        free(job->out_buf);
+        free(job->err_buf);
+        free(job->trace_buf);
+    }
+    if (check_GlobalSymbols(&job->globals, stderr) > 0) {
+        job->status = 1;
+    }
+}
+
 void print_usage(char *argv0) {
     int i, count = sizeof(options_help) / sizeof(*options_help);
     printf("Usage: %s [options] file...\n", argv0);
@@ -1,202 +1,207 @@
 #include "map.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct entry Entry;
-typedef struct data  Data;
+/* Open addressing with Robin Hood probing: an entry may displace another one
+ * that sits closer to its home slot, which keeps probe sequences short and
+ * lets lookups stop as soon as they reach an entry poorer than the key. */
 
-struct entry {
-    Entry         *next;
-    const void    *key;
-    size_t        len;
-    const void    *value;
-    unsigned long hash;
+#define MAP_INLINE_KEY 16   // Keys up to this many bytes live in the slot
+#define MAP_MAX_LOAD_FACTOR 0.95
+
+typedef struct slot Slot;
+typedef struct data Data;
+
+struct slot {
+    uint64_t   hash;        // 0 marks an empty slot
+    size_t     len;
+    const void *value;
+    union {
+        char inline_key[MAP_INLINE_KEY];
+        char *heap_key;
+    } key;
 };
 
 struct data {
     size_t size;
-    size_t capacity;
-    size_t cap_diff;
+    size_t capacity;        // Always a power of two
+    size_t max_size;        // Grow before size exceeds this
     double load_factor;
-    Entry  **entries;
+    Slot   *slots;
 };
 
-Entry *new_Entry(const void *key,
-                 size_t len,
-                 const void *value,
-                 unsigned long hash) {
-    Entry *new = malloc(sizeof(*new));
-    if (new == NULL) {
-        return NULL;
-    }
-    new->next = NULL;
-    new->key = malloc(len);
-    if (new->key == NULL) {
-        free(new);
-        return NULL;
-    }
-    memcpy((void*)new->key, key, len);
-    new->len = len;
-    new->value = value;
-    new->hash = hash;
-    return new;
+static inline const char *slot_key(const Slot *slot) {
+    return slot->len <= MAP_INLINE_KEY ? slot->key.inline_key
+                                       : slot->key.heap_key;
 }
 
-unsigned long hash(const char *key, size_t len) {
-    /* djb2 hash function
-     * http://www.cse.yorku.ca/~oz/hash.html
-     */
-    unsigned long hash = 5381;
-    size_t i;
-    for (i = 0; i < len; i++) {
-        hash = ((hash << 5u) + hash) + *key++;
-    }
-    return hash;
+static inline uint64_t load_word(const unsigned char *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint64_t mix(uint64_t h) {
+    // Finalizer from MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Consumes the key eight bytes at a time and folds the tail into a final
+ * word, so short identifiers hash in a couple of multiplications. */
+uint64_t hash_Map(const void *key, size_t len) {
+    const unsigned char *p = key;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * 0x100000001b3ULL);
+    for (; len >= sizeof(uint64_t); p += sizeof(uint64_t),
+                                    len -= sizeof(uint64_t)) {
+        h = (h ^ mix(load_word(p))) * 0x100000001b3ULL;
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < len; i++) {
+        tail |= (uint64_t)p[i] << (8 * i);
+    }
+    h = mix(h ^ tail);
+    return h ? h : 1;
+}
+
+static inline size_t home(const Data *data, uint64_t h) {
+    return h & (data->capacity - 1);
+}
+
+static inline size_t distance(const Data *data, const Slot *slot, size_t i) {
+    return (i - home(data, slot->hash)) & (data->capacity - 1);
 }
 
-int keycmp(const char *key1, size_t len1, const char *key2, size_t len2) {
-    for (; len1 && len2; key1++, len1--, key2++, len2--) {
-        if (*key1 != *key2) { return *key1 - *key2; }
+static Slot *find(const Data *data, const void *key, size_t len) {
+    uint64_t h = hash_Map(key, len);
+    size_t mask = data->capacity - 1;
+    for (size_t i = home(data, h), dist = 0; ; i = (i + 1) & mask, dist++) {
+        Slot *slot = &data->slots[i];
+        if (slot->hash == 0 || distance(data, slot, i) < dist) {
+            return NULL;
+        }
+        if (slot->hash == h && slot->len == len &&
+            memcmp(slot_key(slot), key, len) == 0) {
+            return slot;
+        }
     }
-    if (len1 != len2) {
-        return (int)len1 - (int)len2;
+}
+
+/* Places 'new', which must not already be in the table, displacing richer
+ * entries along the way. There must be at least one empty slot. */
+static void place(Data *data, Slot new) {
+    size_t mask = data->capacity - 1;
+    size_t dist = 0;
+    for (size_t i = home(data, new.hash); ; i = (i + 1) & mask, dist++) {
+        Slot *slot = &data->slots[i];
+        if (slot->hash == 0) {
+            *slot = new;
+            return;
+        }
+        size_t slot_dist = distance(data, slot, i);
+        if (slot_dist < dist) {
+            Slot tmp = *slot;
+            *slot = new;
+            new = tmp;
+            dist = slot_dist;
+        }
     }
-    return 0;
 }
 
-int resize(const Map *this) {
-    Data *data = this->data;
-    size_t capacity = data->capacity + data->cap_diff;
-    Entry **new_entries = calloc(capacity, sizeof(*new_entries));
-    if (new_entries == NULL) {
+static size_t max_size(size_t capacity, double load_factor) {
+    size_t max = capacity * load_factor;
+    return max < capacity ? max : capacity - 1;
+}
+
+static int resize(Data *data, size_t capacity) {
+    Slot *old = data->slots;
+    size_t old_capacity = data->capacity;
+    Slot *slots = calloc(capacity, sizeof(*slots));
+    if (slots == NULL) {
         return 1;
     }
-    for (size_t i = 0; i < data->capacity; i++) {
-        for (Entry *old = data->entries[i]; old != NULL; ) {
-            unsigned long h = old->hash % capacity;
-            Entry **n;
-            for (n = &new_entries[h]; *n != NULL; n = &(*n)->next) {
-                if (keycmp(old->key, old->len, (*n)->key, (*n)->len) <= 0) {
-                    break;
-                }
-            }
-            Entry *tmp = old->next;
-            old->next = *n;
-            *n = old;
-            old = tmp;
+    data->slots = slots;
+    data->capacity = capacity;
+    data->max_size = max_size(capacity, data->load_factor);
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].hash != 0) {
+            place(data, old[i]);
         }
     }
-    free(data->entries);
-    data->entries = new_entries;
-    data->capacity = capacity;
+    free(old);
     return 0;
 }
 
-int map_put(const Map *this,
-            const void *key,
-            size_t len,
-            const void *value,
-            const void *prev_ptr) {
+static int map_put(const Map *this,
+                   const void *key,
+                   size_t len,
+                   const void *value,
+                   const void *prev_ptr) {
     Data *data = this->data;
-    int h = hash(key, len);
-    Entry **curr;
-    for (curr = &data->entries[h % data->capacity];
-         *curr != NULL;
-         curr = &(*curr)->next) {
-        int cmp = keycmp(key, len, (*curr)->key, (*curr)->len);
-        if (cmp == 0) {
-            if (prev_ptr == NULL) {
-                return 1;
-            }
-            *(const void**)prev_ptr = (*curr)->value;
-            (*curr)->value = value;
-            return 0;
-        } else if (cmp < 0) {
-            Entry *new = new_Entry(key, len, value, h);
-            if (new == NULL) {
-                return 1;
-            }
-            new->next = *curr;
-            *curr = new;
-            data->size++;
-            if ((double)data->size / data->capacity >= data->load_factor) {
-                if (resize(this)) {
-                    return 1;
-                }
-            }
-            return 0;
+    Slot *slot = find(data, key, len);
+    if (slot != NULL) {
+        if (prev_ptr == NULL) {
+            return 1;
         }
+        *(const void**)prev_ptr = slot->value;
+        slot->value = value;
+        return 0;
     }
-    Entry *new = new_Entry(key, len, value, h);
-    if (new == NULL) {
+    if (data->size + 1 > data->max_size &&
+        resize(data, data->capacity * 2)) {
         return 1;
     }
-    *curr = new;
-    data->size++;
-    if ((double)data->size / data->capacity >= data->load_factor) {
-        if (resize(this)) {
+    Slot new = { .hash = hash_Map(key, len), .len = len, .value = value };
+    if (len <= MAP_INLINE_KEY) {
+        memcpy(new.key.inline_key, key, len);
+    } else {
+        new.key.heap_key = malloc(len);
+        if (new.key.heap_key == NULL) {
             return 1;
         }
+        memcpy(new.key.heap_key, key, len);
     }
+    place(data, new);
+    data->size++;
     return 0;
 }
 
-int map_get(const Map *this,
-            const void *key,
-            size_t len,
-            const void *value_ptr) {
-    Data *data = this->data;
-    int h = hash(key, len);
-    Entry *curr;
-    for (curr = data->entries[h % data->capacity];
-         curr != NULL;
-         curr = curr->next) {
-        int cmp = keycmp(key, len, curr->key, curr->len);
-        if (cmp == 0) {
-            if (value_ptr == NULL) {
-                return 1;
-            }
-            *(const void**)value_ptr = curr->value;
-            return 0;
-        } else if (cmp < 0) {
-            return 1;
-        }
+static int map_get(const Map *this,
+                   const void *key,
+                   size_t len,
+                   const void *value_ptr) {
+    Slot *slot = find(this->data, key, len);
+    if (slot == NULL || value_ptr == NULL) {
+        return 1;
     }
-    return 1;
+    *(const void**)value_ptr = slot->value;
+    return 0;
 }
 
-int map_contains(const Map *this, const void *key, size_t len) {
-    Data *data = this->data;
-    int h = hash(key, len);
-    Entry *curr;
-    for (curr = data->entries[h % data->capacity];
-         curr != NULL;
-         curr = curr->next) {
-        int cmp = keycmp(key, len, curr->key, curr->len);
-        if (cmp == 0) {
-            return 1;
-        } else if (cmp < 0) {
-            return 0;
-        }
-    }
-    return 0;
+static int map_contains(const Map *this, const void *key, size_t len) {
+    return find(this->data, key, len) != NULL;
 }
 
-void map_free(const Map *this, void (*val_free)(void*)) {
+static void map_free(const Map *this, void (*val_free)(void*)) {
     Data *data = this->data;
     for (size_t i = 0; i < data->capacity; i++) {
-        Entry *curr = data->entries[i];
-        while (curr != NULL) {
-            Entry *next = curr->next;
-            if (val_free != NULL) {
-                val_free((void*)curr->value);
-            }
-            free((void*)curr->key);
-            free(curr);
-            curr = next;
+        Slot *slot = &data->slots[i];
+        if (slot->hash == 0) {
+            continue;
+        }
+        if (val_free != NULL) {
+            val_free((void*)slot->value);
+        }
+        if (slot->len > MAP_INLINE_KEY) {
+            free(slot->key.heap_key);
         }
     }
-    free(data->entries);
+    free(data->slots);
     free(data);
     free((void*)this);
 }
@@ -206,18 +211,25 @@ const Map *new_Map(size_t capacity, double load_factor) {
     if (data == NULL) {
         return NULL;
     }
+    if (load_factor <= 0) {
+        load_factor = MAP_LOAD_FACTOR;
+    } else if (load_factor > MAP_MAX_LOAD_FACTOR) {
+        load_factor = MAP_MAX_LOAD_FACTOR;
+    }
+    size_t requested = capacity <= 0 ? MAP_CAPACITY : capacity;
+    for (capacity = 2; capacity < requested; capacity *= 2);
     data->size = 0;
-    data->capacity    = capacity    <= 0 ? MAP_CAPACITY    : capacity;
-    data->cap_diff = capacity;
-    data->load_factor = load_factor <= 0 ? MAP_LOAD_FACTOR : load_factor;
-    data->entries = calloc(data->capacity, sizeof(*data->entries));
-    if (data->entries == NULL) {
+    data->capacity = capacity;
+    data->max_size = max_size(capacity, load_factor);
+    data->load_factor = load_factor;
+    data->slots = calloc(data->capacity, sizeof(*data->slots));
+    if (data->slots == NULL) {
         free(data);
         return NULL;
     }
     Map *m = malloc(sizeof(*m));
     if (m == NULL) {
-        free(data->entries);
+        free(data->slots);
         free(data);
         return NULL;
     }
@@ -227,5 +239,4 @@ const Map *new_Map(size_t capacity, double load_factor) {
     m->contains = map_contains;
     m->free     = map_free;
     return m;
-
-}
\ No newline at end of file
+}
@@ -0,0 +1,89 @@
+#include "optimizer.h"
+#include <stdlib.h>
+
+/* Replace every load whose global already has a known value in the block:
+ * the value last stored to it, or else the value it was last loaded as.
+ * Loads before any store in the block read what came before it, and stay. */
+static void propagate(IR *ir, IRValue *known, IRValue *replacement) {
+    for (int b = 0; b < ir->blocks.size; b++) {
+        const IRBlock *block = &ir->blocks.values[b];
+        for (int i = 0; i < ir->globals.size; i++) {
+            known[i] = IR_NONE;
+        }
+        for (IRValue value = block->first; value < block->end; value++) {
+            replacement[value] = value;
+            // Operands come first, so their replacements are final
+            if (ir->operands[value] != IR_NONE) {
+                ir->operands[value] = replacement[ir->operands[value]];
+            }
+            uint32_t global = ir->args[value];
+            if (ir->ops[value] == IR_STORE) {
+                known[global] = ir->operands[value];
+            } else if (ir->ops[value] == IR_LOAD) {
+                if (known[global] != IR_NONE) {
+                    replacement[value] = known[global];
+                } else {
+                    known[global] = value;
+                }
+            }
+        }
+    }
+}
+
+/* Walk each block backwards, deleting stores that a later store overwrites
+ * before anything loads the global, and values nothing uses. Deleting a
+ * value drops a use of its operand, which comes earlier and so is seen
+ * after it. */
+static void eliminate(IR *ir, uint32_t *uses, char *overwritten) {
+    for (IRValue value = 0; value < ir->size; value++) {
+        uses[value] = use_count_IR(ir, value);
+    }
+    for (int b = 0; b < ir->blocks.size; b++) {
+        const IRBlock *block = &ir->blocks.values[b];
+        for (int i = 0; i < ir->globals.size; i++) {
+            overwritten[i] = 0;
+        }
+        for (IRValue value = block->end; value-- > block->first;) {
+            uint32_t global = ir->args[value];
+            if (ir->ops[value] == IR_STORE) {
+                if (!overwritten[global]) {
+                    overwritten[global] = 1;
+                    continue;
+                }
+            } else if (uses[value] > 0) {
+                if (ir->ops[value] == IR_LOAD) {
+                    overwritten[global] = 0;
+                }
+                continue;
+            }
+            if (ir->operands[value] != IR_NONE) {
+                uses[ir->operands[value]]--;
+            }
+            ir->ops[value] = IR_NOP;
+        }
+    }
+}
+
+int optimize_IR(IR *ir, int level) {
+    if (level <= 0) {
+        return 0;
+    }
+    size_t globals = ir->globals.size + 1;
+    IRValue *known = malloc(globals * sizeof(*known));
+    IRValue *values = malloc((ir->size + 1) * sizeof(*values));
+    char *overwritten = malloc(globals);
+    int status = known == NULL || values == NULL || overwritten == NULL;
+    if (status == 0) {
+        propagate(ir, known, values);
+        status = index_IR(ir);
+    }
+    if (status == 0) {
+        // The replacements are done with, so reuse them as use counts
+        eliminate(ir, values, overwritten);
+        status = compact_IR(ir);
+    }
+    free(known);
+    free(values);
+    free(overwritten);
+    return status;
+}
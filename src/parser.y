@@ -13,6 +13,7 @@
     void yyerror(YYLTYPE *locp,
                  const ASTNode **root,
                  const char *filename,
+                 const ASTBuilder *builder,
                  yyscan_t scanner,
                  const char *msg);
 %}
@@ -21,8 +22,19 @@
     #define YY_DECL int yylex (YYSTYPE *yylval_param, \
         YYLTYPE *yylloc_param, \
         const char *filename, \
+        const ASTBuilder *builder, \
         yyscan_t yyscanner)
     YY_DECL;
+
+    /* Per-scanner state, installed as the scanner's yyextra. If trace is
+     * non-NULL every token is written to it; errors are reported to
+     * diagnostics. */
+    typedef struct scanner_state ScannerState;
+    ScannerState *new_ScannerState(FILE *trace, FILE *diagnostics);
+    FILE *diagnostics_ScannerState(const ScannerState *state);
+    // Tokens passed to the parser so far
+    size_t tokens_ScannerState(const ScannerState *state);
+    void free_ScannerState(ScannerState *state);
 }
 
 %code requires {
@@ -38,12 +50,14 @@
 %define api.pure full
 %locations
 %parse-param { const ASTNode **root }
-%param { const char *filename } { yyscan_t scanner }
+%param { const char *filename }
+%param { const ASTBuilder *builder }
+%param { yyscan_t scanner }
 
 %union {
     int     int_val;
     double  double_val;
-    char    *str_val;
+    Symbol  const *symbol_val;
     ASTNode const *ast;
     Vector  const *vec;
 }
@@ -51,10 +65,13 @@
 %token             INDENT OUTDENT ERROR NEWLINE
 %token<int_val>    INT_LIT
 %token<double_val> DOUBLE_LIT
-%token<str_val>    IDENT
+%token<symbol_val> IDENT
 
 %type<ast> file statement assignment lvalue expr
-%type<vec> stmts
+%type<vec> stmts targets
+
+    // Release the lists of statements and targets dropped by a syntax error
+%destructor { if ($$ != NULL) $$->free($$, NULL); } <vec>
 
 %start file
 
@@ -63,11 +80,11 @@
 file:
     %empty
         {
-            *root = new_ProgramNode(&@$, 0);
+            *root = new_ProgramNode(builder, &@$, 0);
         }
   | stmts
         {
-            *root = new_ProgramNode(&@$, $1);
+            *root = new_ProgramNode(builder, &@$, $1);
         }
 
 stmts:
@@ -88,20 +105,44 @@ statement:
             $$ = $1;
         }
 
+    /* a = b = c is collected left to right and then folded into the
+     * right-nested assignments, so long chains don't grow the parser stack */
 assignment:
-    expr
+    targets expr
         {
-            $$ = $1;
+            $$ = $2;
+            if ($1 != NULL) {
+                const ASTNode *const *lvalues;
+                int count;
+                lvalues = (const ASTNode *const *)$1->view($1, &count);
+                for (int i = count - 1; i >= 0; i--) {
+                    YYLTYPE loc = {
+                        lvalues[i]->loc.first_line,
+                        lvalues[i]->loc.first_column,
+                        @2.last_line,
+                        @2.last_column
+                    };
+                    $$ = new_AssignmentNode(builder, &loc, lvalues[i], $$);
+                }
+                $1->free($1, NULL);
+            }
+        }
+
+targets:
+    %empty
+        {
+            $$ = NULL;
         }
-  | lvalue '=' assignment
+  | targets lvalue '='
         {
-            $$ = new_AssignmentNode(&@$, $1, $3);
+            $$ = $1 != NULL ? $1 : new_Vector(0);
+            $$->append($$, $2);
         }
 
 lvalue:
     IDENT
         {
-            $$ = new_VariableNode(&@$, $1);
+            $$ = new_VariableNode(builder, &@$, $1);
         }
 
 expr:
@@ -111,11 +152,11 @@ expr:
         }
   | INT_LIT
         {
-            $$ = new_IntNode(&@$, $1);
+            $$ = new_IntNode(builder, &@$, $1);
         };
   | DOUBLE_LIT
         {
-            $$ = new_LeafNode(&@$);
+            $$ = new_DoubleNode(builder, &@$, $1);
         };
 
 %%
@@ -123,10 +164,11 @@ expr:
 void yyerror(YYLTYPE *locp,
     UNUSED const ASTNode **root,
     const char *filename,
-    UNUSED yyscan_t scanner,
+    UNUSED const ASTBuilder *builder,
+    yyscan_t scanner,
     const char *msg
 ) {
-    fprintf(stderr,
+    fprintf(diagnostics_ScannerState(yyget_extra(scanner)),
         "%s:%d:%d: " ERROR "%s\n",
         filename,
         locp->first_line,
@@ -0,0 +1,85 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+struct pool {
+    int  count;
+    int  next;      // Next task to hand out
+    char *done;     // done[i] is set once task i has completed
+    void (*task)(void*, int);
+    void *ctx;
+    pthread_mutex_t lock;
+    pthread_cond_t  finished;
+};
+
+static void *worker(void *arg) {
+    struct pool *pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->count) {
+            return NULL;
+        }
+        pool->task(pool->ctx, i);
+        pthread_mutex_lock(&pool->lock);
+        pool->done[i] = 1;
+        pthread_cond_broadcast(&pool->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void serial_for(int first, int count, void (*task)(void*, int),
+                       void (*finish)(void*, int), void *ctx) {
+    for (int i = first; i < count; i++) {
+        task(ctx, i);
+        if (finish != NULL) {
+            finish(ctx, i);
+        }
+    }
+}
+
+void parallel_for(int threads, int count, void (*task)(void*, int),
+                  void (*finish)(void*, int), void *ctx) {
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads <= 1) {
+        serial_for(0, count, task, finish, ctx);
+        return;
+    }
+    struct pool pool = { count, 0, calloc(count, 1), task, ctx,
+                         PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+    pthread_t *workers = malloc(threads * sizeof(*workers));
+    int started = 0;
+    if (pool.done != NULL && workers != NULL) {
+        while (started < threads &&
+               !pthread_create(&workers[started], NULL, worker, &pool)) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        // Could not start any threads, do the work on this one instead
+        free(pool.done);
+        free(workers);
+        serial_for(0, count, task, finish, ctx);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.done[i]) {
+            pthread_cond_wait(&pool.finished, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+        if (finish != NULL) {
+            finish(ctx, i);
+        }
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.finished);
+    free(pool.done);
+    free(workers);
+}
@@ -1,36 +1,71 @@
 #include "queue.h"
+#include <limits.h> // UINT_MAX
 #include <stdlib.h>
+#include <string.h> // memcpy()
 
 struct queue_data {
     const void **values;
-    int capacity;
-    int cap_diff;
-    int size;
-    int front;
-    int back;
+    unsigned capacity;  // Always a power of two
+    unsigned mask;      // capacity - 1
+    unsigned size;
+    unsigned front;
 };
 
-static int queue_push(const Queue *this, const void *val) {
-    struct queue_data *data = this->data;
-    if (data->size + 1 == data->capacity) {
-        size_t new_cap = data->capacity + data->cap_diff;
-        const void **new_values =
-            realloc(data->values, new_cap * sizeof(const void*));
-        if (new_values == NULL) {
+/* Grows the ring until it can hold 'needed' values, doubling the capacity
+ * each time. realloc() keeps values at the same indices, so only the part
+ * that had wrapped around to the start needs to move past the old end. */
+static int reserve(struct queue_data *data, unsigned needed) {
+    if (needed <= data->capacity) {
+        return 0;
+    }
+    unsigned new_cap = data->capacity;
+    while (new_cap < needed) {
+        if (new_cap > UINT_MAX / 2) {
             return 1;
         }
-        if (data->back < data->front) {
-            for (int i = 0; i < data->back; i++) {
-                data->values[(data->capacity + i) % new_cap] = data->values[i];
-            }
-            data->back = (data->capacity + data->back) % new_cap;
-        }
-        data->values = new_values;
-        data->capacity = new_cap;
+        new_cap *= 2;
+    }
+    const void **new_values =
+        realloc(data->values, new_cap * sizeof(const void*));
+    if (new_values == NULL) {
+        return 1;
+    }
+    if (data->front + data->size > data->capacity) {
+        unsigned wrapped = data->front + data->size - data->capacity;
+        memcpy(new_values + data->capacity, new_values,
+               wrapped * sizeof(const void*));
+    }
+    data->values = new_values;
+    data->capacity = new_cap;
+    data->mask = new_cap - 1;
+    return 0;
+}
+
+static int queue_push(const Queue *this, const void *val) {
+    struct queue_data *data = this->data;
+    if (data->size == data->capacity && reserve(data, data->size + 1)) {
+        return 1;
+    }
+    data->values[(data->front + data->size++) & data->mask] = val;
+    return 0;
+}
+
+static int queue_push_n(const Queue *this, const void *const *vals,
+                        int count) {
+    struct queue_data *data = this->data;
+    if (count < 0 || (unsigned)count > UINT_MAX - data->size ||
+        reserve(data, data->size + count)) {
+        return 1;
+    }
+    // Copy in at most two runs: up to the end of the array, then from 0
+    unsigned back = (data->front + data->size) & data->mask;
+    unsigned head = data->capacity - back;
+    if (head > (unsigned)count) {
+        head = count;
     }
-    data->values[data->back] = val;
-    data->size++;
-    data->back = (data->back + 1) % data->capacity;
+    memcpy(data->values + back, vals, head * sizeof(const void*));
+    memcpy(data->values, vals + head, (count - head) * sizeof(const void*));
+    data->size += count;
     return 0;
 }
 
@@ -39,22 +74,38 @@ static int queue_pop(const Queue *this, const void *val_ptr) {
     if (val_ptr == NULL) {
         return 1;
     }
-    if (data->size <= 0) {
+    if (data->size == 0) {
         *(const void**)val_ptr = NULL;
         return 1;
     }
     *(const void**)val_ptr = data->values[data->front];
-    data->front = (data->front + 1) % data->capacity;
+    data->front = (data->front + 1) & data->mask;
     data->size--;
     return 0;
 }
 
+static int queue_pop_n(const Queue *this, const void **vals, int count) {
+    struct queue_data *data = this->data;
+    if (vals == NULL || count < 0 || (unsigned)count > data->size) {
+        return 1;
+    }
+    unsigned head = data->capacity - data->front;
+    if (head > (unsigned)count) {
+        head = count;
+    }
+    memcpy(vals, data->values + data->front, head * sizeof(const void*));
+    memcpy(vals + head, data->values, (count - head) * sizeof(const void*));
+    data->front = (data->front + count) & data->mask;
+    data->size -= count;
+    return 0;
+}
+
 static int queue_front(const Queue *this, const void *val_ptr) {
     struct queue_data *data = this->data;
     if (val_ptr == NULL) {
         return 1;
     }
-    if (data->size <= 0) {
+    if (data->size == 0) {
         *(const void**)val_ptr = NULL;
         return 1;
     }
@@ -70,8 +121,8 @@ static int queue_size(const Queue *this) {
 static void queue_free(const Queue *this, void (*val_free)(const void*)) {
     struct queue_data *data = this->data;
     if (val_free != NULL) {
-        for (int i = 0; i < data->size; i++) {
-            val_free(data->values[(data->front + i) % data->capacity]);
+        for (unsigned i = 0; i < data->size; i++) {
+            val_free(data->values[(data->front + i) & data->mask]);
         }
     }
     free(data->values);
@@ -84,8 +135,13 @@ const Queue *new_Queue(int capacity) {
     if (data == NULL) {
         return NULL;
     }
-    int cap = capacity > 0 ? capacity : QUEUE_CAPACITY;
-    data->capacity = data->cap_diff = cap;
+    unsigned requested = capacity > 0 ? capacity : QUEUE_CAPACITY;
+    unsigned cap = 1;
+    while (cap < requested && cap <= UINT_MAX / 2) {
+        cap *= 2;
+    }
+    data->capacity = cap;
+    data->mask = cap - 1;
     data->values = malloc(cap * sizeof(const void*));
     if (data->values == NULL) {
         free(data);
@@ -93,19 +149,19 @@ const Queue *new_Queue(int capacity) {
     }
     data->size = 0;
     data->front = 0;
-    data->back = 0;
     Queue *queue = malloc(sizeof(*queue));
     if (queue == NULL) {
         free(data->values);
         free(data);
         return NULL;
     }
-    queue->data  = data;
-    queue->push  = queue_push;
-    queue->pop   = queue_pop;
-    queue->front = queue_front;
-    queue->size  = queue_size;
-    queue->free  = queue_free;
+    queue->data   = data;
+    queue->push   = queue_push;
+    queue->push_n = queue_push_n;
+    queue->pop    = queue_pop;
+    queue->pop_n  = queue_pop_n;
+    queue->front  = queue_front;
+    queue->size   = queue_size;
+    queue->free   = queue_free;
     return queue;
 }
-
@@ -0,0 +1,76 @@
+#include "regalloc.h"
+#include <stdlib.h>
+
+RegisterAllocation *new_RegisterAllocation(const IR *ir, uint32_t registers,
+                                           const IRValue *ends) {
+    RegisterAllocation *allocation = calloc(1, sizeof(*allocation));
+    if (allocation == NULL) {
+        return NULL;
+    }
+    allocation->registers = registers;
+    allocation->locations = malloc((ir->size + 1) *
+                                   sizeof(*allocation->locations));
+    // The values holding a register, by increasing interval end
+    IRValue *active = malloc((registers + 1) * sizeof(*active));
+    uint32_t *free_registers = malloc((registers + 1) *
+                                      sizeof(*free_registers));
+    if (allocation->locations == NULL || active == NULL ||
+        free_registers == NULL) {
+        free(active);
+        free(free_registers);
+        free_RegisterAllocation(allocation);
+        return NULL;
+    }
+    uint32_t active_size = 0, free_size = registers;
+    for (uint32_t r = 0; r < registers; r++) {
+        free_registers[r] = registers - 1 - r;
+    }
+    uint32_t *locations = allocation->locations;
+    for (IRValue value = 0; value < ir->size; value++) {
+        locations[value] = REGALLOC_NONE;
+        IRValue end = ends[value];
+        if (end == IR_NONE) {
+            continue;
+        }
+        /* Expire the intervals that end here: an instruction reads its
+         * operands before it writes its result, so it may reuse their
+         * registers. */
+        uint32_t expired = 0;
+        while (expired < active_size &&
+               ends[active[expired]] <= value) {
+            free_registers[free_size++] = locations[active[expired++]];
+        }
+        active_size -= expired;
+        for (uint32_t i = 0; i < active_size; i++) {
+            active[i] = active[i + expired];
+        }
+        IRValue spilled = value;
+        if (free_size > 0) {
+            locations[value] = free_registers[--free_size];
+            spilled = IR_NONE;
+        } else if (active_size > 0 &&
+                   ends[active[active_size - 1]] > end) {
+            // Take the register of the interval that ends last
+            spilled = active[--active_size];
+            locations[value] = locations[spilled];
+        }
+        if (spilled != IR_NONE) {
+            locations[spilled] = registers + allocation->spill_slots++;
+        }
+        if (locations[value] < registers) {
+            uint32_t i = active_size++;
+            for (; i > 0 && ends[active[i - 1]] > end; i--) {
+                active[i] = active[i - 1];
+            }
+            active[i] = value;
+        }
+    }
+    free(active);
+    free(free_registers);
+    return allocation;
+}
+
+void free_RegisterAllocation(RegisterAllocation *allocation) {
+    free(allocation->locations);
+    free(allocation);
+}
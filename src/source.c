@@ -0,0 +1,109 @@
+#include "source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // memset()
+#include <errno.h>
+#include <fcntl.h>  // open()
+#include <unistd.h> // close(), read(), sysconf()
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Flex needs the buffer to end with two YY_END_OF_BUFFER_CHARs
+#define SOURCE_PADDING 2
+#define SOURCE_READ_SIZE (64 * 1024)
+
+/* Map a regular file, followed by enough zero bytes for the padding. An
+ * anonymous mapping is reserved first and the file is mapped over its start;
+ * the rest of the file's last page and anything past it read as zero. The
+ * mapping is private because flex briefly writes into the buffer. */
+static int map_file(Source *src, int fd, size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t capacity = (size + SOURCE_PADDING + page - 1) / page * page;
+    char *base = mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return 1;
+    }
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(base, capacity);
+        return 1;
+    }
+    src->data = base;
+    src->size = size;
+    src->capacity = capacity;
+    src->mapped = 1;
+    return 0;
+}
+
+// Fallback for pipes, devices and anything else that can't be mapped
+static int read_file(Source *src, int fd) {
+    size_t size = 0, capacity = SOURCE_READ_SIZE;
+    char *data = malloc(capacity);
+    if (data == NULL) {
+        return 1;
+    }
+    for (;;) {
+        if (capacity - size < SOURCE_PADDING + 1) {
+            char *new_data = realloc(data, capacity * 2);
+            if (new_data == NULL) {
+                free(data);
+                return 1;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, data + size, capacity - size - SOURCE_PADDING);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(data);
+            return 1;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    memset(data + size, 0, SOURCE_PADDING);
+    src->data = data;
+    src->size = size;
+    src->capacity = capacity;
+    src->mapped = 0;
+    return 0;
+}
+
+Source *new_Source(const char *filename) {
+    Source *src = malloc(sizeof(*src));
+    if (src == NULL) {
+        return NULL;
+    }
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        free(src);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        map_file(src, fd, st.st_size)) {
+        if (read_file(src, fd)) {
+            int saved = errno;
+            close(fd);
+            free(src);
+            errno = saved;
+            return NULL;
+        }
+    }
+    close(fd);
+    return src;
+}
+
+void free_Source(Source *src) {
+    if (src->mapped) {
+        munmap(src->data, src->capacity);
+    } else {
+        free(src->data);
+    }
+    free(src);
+}
@@ -0,0 +1,219 @@
+#include "time_report.h"
+#include <sys/resource.h>   // getrusage()
+
+static const char *const phase_names[PHASE_COUNT] = {
+    [PHASE_PARSE]    = "parse",
+    [PHASE_CHECK]    = "check",
+    [PHASE_IR]       = "ir",
+    [PHASE_EMIT]     = "emit",
+    [PHASE_TEARDOWN] = "teardown",
+    [PHASE_CC]       = "cc",
+    [PHASE_RUN]      = "run"
+};
+
+static double seconds(struct timespec time) {
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static double rusage_seconds(const struct rusage *usage) {
+    return usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6 +
+           usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+}
+
+// CPU time of this thread and of the children waited for
+static double cpu_seconds(void) {
+    struct timespec time;
+    struct rusage children;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    getrusage(RUSAGE_CHILDREN, &children);
+    return seconds(time) + rusage_seconds(&children);
+}
+
+void start_TimeReport(TimeReport *report) {
+    if (report == NULL) {
+        return;
+    }
+    *report = (TimeReport){ 0 };
+    clock_gettime(CLOCK_MONOTONIC, &report->start);
+    report->lap_wall = report->start;
+    report->lap_cpu = cpu_seconds();
+}
+
+void lap_TimeReport(TimeReport *report, Phase phase) {
+    if (report == NULL) {
+        return;
+    }
+    struct timespec wall;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    double cpu = cpu_seconds();
+    if (phase != PHASE_NONE) {
+        report->phases[phase].wall += seconds(wall) -
+                                      seconds(report->lap_wall);
+        report->phases[phase].cpu += cpu - report->lap_cpu;
+    }
+    report->lap_wall = wall;
+    report->lap_cpu = cpu;
+}
+
+// A fixed-point number of seconds, which writer_double() won't do
+static void write_seconds(double val, Writer *out) {
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%10.6f", val);
+    writer_str(out, digits);
+}
+
+static void write_count(const char *name, size_t val, Writer *out) {
+    writer_str(out, "  ");
+    writer_str(out, name);
+    writer_str(out, ": ");
+    writer_int(out, (long)val);
+    writer_char(out, '\n');
+}
+
+static void text_time(const char *name, const PhaseTime *time, Writer *out) {
+    writer_str(out, "  ");
+    writer_str(out, name);
+    writer_bytes(out, "          ", 10 - strlen(name));
+    write_seconds(time->wall, out);
+    writer_str(out, "s wall");
+    write_seconds(time->cpu, out);
+    writer_str(out, "s cpu\n");
+}
+
+static void text_report(const char *name, const TimeReport *report,
+                        int phases, Writer *out) {
+    writer_str(out, name);
+    writer_str(out, ":\n");
+    for (int phase = 0; phase < phases; phase++) {
+        text_time(phase_names[phase], &report->phases[phase], out);
+    }
+    write_count("tokens", report->tokens, out);
+    write_count("nodes", report->nodes, out);
+    write_count("arena bytes", report->arena_bytes, out);
+}
+
+static void json_string(const char *str, Writer *out) {
+    writer_char(out, '"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            writer_char(out, '\\');
+        }
+        writer_char(out, *str);
+    }
+    writer_char(out, '"');
+}
+
+static void json_time(const char *name, const PhaseTime *time, int indent,
+                      Writer *out) {
+    writer_key(out, name);
+    writer_char(out, '{');
+    writer_indent(out, indent + 1);
+    writer_key(out, "wall");
+    writer_double(out, time->wall);
+    writer_char(out, ',');
+    writer_indent(out, indent + 1);
+    writer_key(out, "cpu");
+    writer_double(out, time->cpu);
+    writer_indent(out, indent);
+    writer_char(out, '}');
+}
+
+static void json_count(const char *name, size_t val, int indent,
+                       Writer *out) {
+    writer_char(out, ',');
+    writer_indent(out, indent);
+    writer_key(out, name);
+    writer_int(out, (long)val);
+}
+
+// The fields shared by file and total reports, ending an open object
+static void json_report(const TimeReport *report, int phases, int indent,
+                        Writer *out) {
+    writer_key(out, "phases");
+    writer_char(out, '{');
+    for (int phase = 0; phase < phases; phase++) {
+        if (phase > 0) {
+            writer_char(out, ',');
+        }
+        writer_indent(out, indent + 1);
+        json_time(phase_names[phase], &report->phases[phase], indent + 1,
+                  out);
+    }
+    writer_indent(out, indent);
+    writer_char(out, '}');
+    json_count("tokens", report->tokens, indent, out);
+    json_count("nodes", report->nodes, indent, out);
+    json_count("arena_bytes", report->arena_bytes, indent, out);
+}
+
+void write_TimeReport(const TimeReport *files, char *const *filenames,
+                      int count, const TimeReport *program, Writer *out,
+                      int json) {
+    if (program == NULL) {
+        return;
+    }
+    TimeReport total = *program;
+    for (int i = 0; i < count; i++) {
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            total.phases[phase].wall += files[i].phases[phase].wall;
+            total.phases[phase].cpu += files[i].phases[phase].cpu;
+        }
+        total.tokens += files[i].tokens;
+        total.nodes += files[i].nodes;
+        total.arena_bytes += files[i].arena_bytes;
+    }
+    struct timespec now;
+    struct rusage self, children;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    PhaseTime elapsed = {
+        seconds(now) - seconds(program->start),
+        rusage_seconds(&self) + rusage_seconds(&children)
+    };
+    size_t peak_rss = (size_t)self.ru_maxrss * 1024;    // Linux uses KiB
+    if (!json) {
+        for (int i = 0; i < count; i++) {
+            text_report(filenames[i], &files[i], PHASE_CC, out);
+        }
+        text_report("total", &total, PHASE_COUNT, out);
+        text_time("elapsed", &elapsed, out);
+        write_count("peak rss bytes", peak_rss, out);
+        return;
+    }
+    writer_char(out, '{');
+    writer_indent(out, 1);
+    writer_key(out, "files");
+    writer_char(out, '[');
+    for (int i = 0; i < count; i++) {
+        writer_str(out, i > 0 ? ",": "");
+        writer_indent(out, 2);
+        writer_char(out, '{');
+        writer_indent(out, 3);
+        writer_key(out, "file");
+        json_string(filenames[i], out);
+        writer_char(out, ',');
+        writer_indent(out, 3);
+        json_report(&files[i], PHASE_CC, 3, out);
+        writer_indent(out, 2);
+        writer_char(out, '}');
+    }
+    if (count > 0) {
+        writer_indent(out, 1);
+    }
+    writer_str(out, "],");
+    writer_indent(out, 1);
+    writer_key(out, "total");
+    writer_char(out, '{');
+    writer_indent(out, 2);
+    json_report(&total, PHASE_COUNT, 2, out);
+    writer_char(out, ',');
+    writer_indent(out, 2);
+    json_time("elapsed", &elapsed, 2, out);
+    json_count("peak_rss_bytes", peak_rss, 2, out);
+    writer_indent(out, 1);
+    writer_char(out, '}');
+    writer_indent(out, 0);
+    writer_char(out, '}');
+    writer_char(out, '\n');
+}
@@ -1,8 +1,271 @@
 #include "typechecker.h"
-#include "ast.h"
+#include <stdlib.h>
+#include <string.h> // memcpy(), memset()
+#include <stdarg.h> // va_list, va_start(), va_end()
+#include "ast_walk.h"
 
-typedef struct type_checker TypeChecker;
+#define RED     "\033[0;91m"
+#define WHITE   "\033[0m"
+#define ERROR   RED "error: " WHITE
 
-struct type_checker {
+static const char *const type_names[] = {
+    [TYPE_UNKNOWN] = "unknown",
+    [TYPE_ERROR]   = "error",
+    [TYPE_INT]     = "int",
+    [TYPE_DOUBLE]  = "double"
+};
 
-};
\ No newline at end of file
+const char *name_Type(Type type) {
+    return type_names[type];
+}
+
+static void type_error(TypeChecker *checker, const ASTNode *node,
+                       const char *fmt, ...) {
+    va_list args;
+    fprintf(checker->diagnostics, "%s:%d:%d: " ERROR, checker->filename,
+            node->loc.first_line, node->loc.first_column);
+    va_start(args, fmt);
+    vfprintf(checker->diagnostics, fmt, args);
+    va_end(args);
+    fputc('\n', checker->diagnostics);
+    checker->errors++;
+}
+
+/* Make sure every symbol interned so far has a slot, so lookups during the
+ * walk need no bounds checks. */
+static int reserve_types(TypeChecker *checker) {
+    int size = checker->interner->size(checker->interner);
+    if (size <= checker->types_size) {
+        return 0;
+    }
+    Type *types = realloc(checker->types, size * sizeof(*types));
+    if (types == NULL) {
+        return 1;
+    }
+    memset(types + checker->types_size, 0,
+           (size - checker->types_size) * sizeof(*types));
+    checker->types = types;
+    checker->types_size = size;
+    return 0;
+}
+
+typedef struct check_walk {
+    TypeChecker *checker;
+    int         status;     // Nonzero once out of memory
+} CheckWalk;
+
+/* Types flow up the tree in the frames' data fields: every node leaves its
+ * type in its own frame, and the value side of an assignment also hands it
+ * to the assignment's frame. An assignment target is a declaration or a
+ * store rather than a use, so it is handled by its assignment. */
+static void check_leave(ASTWalkFrame *frame, ASTWalkFrame *parent,
+                        void *ctx) {
+    CheckWalk *walk = ctx;
+    TypeChecker *checker = walk->checker;
+    const ASTNode *node = frame->node;
+    int is_target = parent != NULL &&
+                    parent->node->kind == AST_ASSIGNMENT && frame->slot == 0;
+    Type type = TYPE_ERROR;
+    switch (node->kind) {
+        case AST_INT:
+            type = TYPE_INT;
+            break;
+        case AST_DOUBLE:
+            type = TYPE_DOUBLE;
+            break;
+        case AST_VARIABLE: {
+            if (is_target) {
+                return;
+            }
+            const Symbol *name = node->data.variable.name;
+            type = checker->types[name->id];
+            if (type == TYPE_UNKNOWN) {
+                type_error(checker, node, "'%s' is used before it is assigned",
+                           name->name);
+                type = TYPE_ERROR;
+            }
+            break;
+        }
+        case AST_ASSIGNMENT: {
+            const ASTNode *target = node->data.assignment.lhs;
+            const Symbol *name = target->data.variable.name;
+            Type *declared = &checker->types[name->id];
+            type = frame->data;
+            if (*declared == TYPE_UNKNOWN) {
+                *declared = type;
+                TypeDeclaration declaration = { name->id, target };
+                if (append_TypeDeclarations(&checker->declarations,
+                                            declaration)) {
+                    walk->status = 1;
+                }
+            } else if (*declared != type && *declared != TYPE_ERROR &&
+                       type != TYPE_ERROR) {
+                type_error(checker, target, "cannot assign %s to '%s', which "
+                           "has type %s", name_Type(type), name->name,
+                           name_Type(*declared));
+            }
+            break;
+        }
+        default:
+            return;
+    }
+    frame->data = type;
+    if (parent != NULL && parent->node->kind == AST_ASSIGNMENT) {
+        parent->data = type;
+    }
+}
+
+/* Point the shared entry for symbol's name at symbol, if no earlier file
+ * has declared the name. */
+static void lower_first(GlobalName *name, const GlobalSymbol *symbol) {
+    const GlobalSymbol *first = __atomic_load_n(&name->first,
+                                                __ATOMIC_ACQUIRE);
+    while (first->file > symbol->file &&
+           !__atomic_compare_exchange_n(&name->first, &first, symbol, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+/* Share the global scope's declarations with the other files. Conflicts
+ * are only checked later, by check_GlobalSymbols(). Returns nonzero if out
+ * of memory. */
+static int publish_globals(TypeChecker *checker) {
+    int mark = checker->scopes.size > 1 ? checker->scopes.values[1]
+                                        : checker->declarations.size;
+    GlobalSymbols *published = checker->published;
+    // The map points into published, so it must never be reallocated
+    if (reserve_GlobalSymbols(published, mark)) {
+        return 1;
+    }
+    for (int i = 0; i < mark; i++) {
+        const TypeDeclaration *declaration = &checker->declarations.values[i];
+        Type type = checker->types[declaration->id];
+        if (type == TYPE_ERROR) {
+            continue;
+        }
+        // Room was reserved above, so this never fails or moves symbols
+        append_GlobalSymbols(published, (GlobalSymbol){
+            type,
+            checker->file,
+            checker->filename,
+            declaration->target->loc.first_line,
+            declaration->target->loc.first_column,
+            NULL
+        });
+        GlobalSymbol *symbol = &published->values[published->size - 1];
+        const Symbol *name = declaration->target->data.variable.name;
+        GlobalName *entry = malloc(sizeof(*entry) + name->len + 1);
+        if (entry == NULL) {
+            return 1;
+        }
+        entry->first = symbol;
+        memcpy(entry->name, name->name, name->len + 1);
+        GlobalName *existing = NULL;
+        int status = checker->globals->insert(checker->globals, name->name,
+                                              name->len, entry, &existing);
+        if (status != 0) {
+            free(entry);
+        }
+        if (status < 0) {
+            return 1;
+        }
+        if (status > 0) {
+            // Only 'first' ever changes, and only through lower_first()
+            lower_first(existing, symbol);
+            entry = existing;
+        }
+        symbol->name = entry;
+    }
+    return 0;
+}
+
+int check_TypeChecker(TypeChecker *checker, const ASTNode *root) {
+    if (reserve_types(checker)) {
+        return -1;
+    }
+    CheckWalk walk = { checker, 0 };
+    int errors = checker->errors;
+    if (walk_ASTNode(root, NULL, check_leave, &walk, NULL) || walk.status) {
+        return -1;
+    }
+    if (checker->globals != NULL && publish_globals(checker)) {
+        return -1;
+    }
+    return checker->errors - errors;
+}
+
+int check_GlobalSymbols(const GlobalSymbols *globals, FILE *diagnostics) {
+    int errors = 0;
+    for (int i = 0; i < globals->size; i++) {
+        const GlobalSymbol *symbol = &globals->values[i];
+        const GlobalSymbol *first = __atomic_load_n(&symbol->name->first,
+                                                    __ATOMIC_ACQUIRE);
+        if (first->type == symbol->type) {
+            continue;
+        }
+        fprintf(diagnostics, "%s:%d:%d: " ERROR "'%s' has type %s here, but "
+                "%s in %s:%d:%d\n", symbol->filename, symbol->line,
+                symbol->column, symbol->name->name, name_Type(symbol->type),
+                name_Type(first->type), first->filename, first->line,
+                first->column);
+        errors++;
+    }
+    return errors;
+}
+
+int open_scope_TypeChecker(TypeChecker *checker) {
+    return push_TypeScopeStack(&checker->scopes, checker->declarations.size);
+}
+
+void close_scope_TypeChecker(TypeChecker *checker) {
+    int mark;
+    if (pop_TypeScopeStack(&checker->scopes, &mark)) {
+        return;
+    }
+    while (checker->declarations.size > mark) {
+        checker->declarations.size--;
+        int id = checker->declarations.values[checker->declarations.size].id;
+        checker->types[id] = TYPE_UNKNOWN;
+    }
+}
+
+Type lookup_TypeChecker(const TypeChecker *checker, const Symbol *name) {
+    if (name->id >= checker->types_size) {
+        return TYPE_UNKNOWN;
+    }
+    return checker->types[name->id];
+}
+
+TypeChecker *new_TypeChecker(const Interner *interner, const char *filename,
+                             FILE *diagnostics, const ConcurrentMap *globals,
+                             int file, GlobalSymbols *published) {
+    TypeChecker *checker = calloc(1, sizeof(*checker));
+    if (checker == NULL) {
+        return NULL;
+    }
+    checker->interner = interner;
+    checker->filename = filename;
+    checker->diagnostics = diagnostics;
+    checker->globals = globals;
+    checker->file = file;
+    checker->published = published;
+    if (init_TypeDeclarations(&checker->declarations, 0)) {
+        free(checker);
+        return NULL;
+    }
+    if (init_TypeScopeStack(&checker->scopes, 0) ||
+        open_scope_TypeChecker(checker)) {
+        free_TypeScopeStack(&checker->scopes);
+        free_TypeDeclarations(&checker->declarations);
+        free(checker);
+        return NULL;
+    }
+    return checker;
+}
+
+void free_TypeChecker(TypeChecker *checker) {
+    free(checker->types);
+    free_TypeDeclarations(&checker->declarations);
+    free_TypeScopeStack(&checker->scopes);
+    free(checker);
+}
@@ -1,31 +1,65 @@
 #include "vector.h"
+#include <limits.h> // INT_MAX
 #include <stdlib.h>
-#include <string.h> // memcpy()
+#include <string.h> // memcpy(), memmove()
 #include <stdio.h>
 
 struct vector_data {
     const void **values;
     int capacity;
-    int cap_diff;
     int size;
 };
 
+static int resize(struct vector_data *data, int capacity) {
+    const void **new_values =
+        realloc(data->values, capacity * sizeof(const void*));
+    if (new_values == NULL) {
+        return 1;
+    }
+    data->values = new_values;
+    data->capacity = capacity;
+    return 0;
+}
+
+/* Makes room for 'count' more values, growing geometrically so that n
+ * appends cost O(n) in total. */
+static int grow(struct vector_data *data, int count) {
+    if (count > INT_MAX - data->size) {
+        return 1;
+    }
+    int needed = data->size + count;
+    if (needed <= data->capacity) {
+        return 0;
+    }
+    int new_cap = data->capacity;
+    while (new_cap < needed) {
+        new_cap = new_cap > INT_MAX / VECTOR_GROWTH_FACTOR
+                ? INT_MAX
+                : new_cap * VECTOR_GROWTH_FACTOR;
+    }
+    return resize(data, new_cap);
+}
+
 static int vector_append(const Vector *this, const void *val) {
     struct vector_data *data = this->data;
-    if (data->size == data->capacity) {
-        size_t new_cap = data->capacity + data->cap_diff;
-        const void **new_values =
-            realloc(data->values, new_cap * sizeof(const void*));
-        if (new_values == NULL) {
-            return 1;
-        }
-        data->values = new_values;
-        data->capacity = new_cap;
+    if (grow(data, 1)) {
+        return 1;
     }
     data->values[data->size++] = val;
     return 0;
 }
 
+static int vector_append_range(const Vector *this, const void *const *vals,
+                               int count) {
+    struct vector_data *data = this->data;
+    if (count < 0 || grow(data, count)) {
+        return 1;
+    }
+    memcpy(data->values + data->size, vals, count * sizeof(const void*));
+    data->size += count;
+    return 0;
+}
+
 static int vector_get(const Vector *this, int index, const void *val_ptr) {
     struct vector_data *data = this->data;
     if (index < 0 || index >= data->size) {
@@ -59,9 +93,8 @@ static int vector_remove(const Vector *this, int index, const void *prev_ptr) {
     if (prev_ptr != NULL) {
         *(const void**)prev_ptr = data->values[index];
     }
-    for (int i = index; i < data->size - 1; i++) {
-        data->values[i] = data->values[i + 1];
-    }
+    memmove(data->values + index, data->values + index + 1,
+            (data->size - index - 1) * sizeof(const void*));
     data->size--;
     return 0;
 }
@@ -71,6 +104,22 @@ static int vector_size(const Vector *this) {
     return data->size;
 }
 
+static int vector_reserve(const Vector *this, int capacity) {
+    struct vector_data *data = this->data;
+    if (capacity <= data->capacity) {
+        return 0;
+    }
+    return resize(data, capacity);
+}
+
+static int vector_shrink_to_fit(const Vector *this) {
+    struct vector_data *data = this->data;
+    if (data->size == data->capacity || data->size == 0) {
+        return 0;
+    }
+    return resize(data, data->size);
+}
+
 static void **vector_array(const Vector *this, int *size) {
     if (size == NULL) {
         return NULL;
@@ -85,6 +134,14 @@ static void **vector_array(const Vector *this, int *size) {
     return values;
 }
 
+static const void *const *vector_view(const Vector *this, int *size) {
+    struct vector_data *data = this->data;
+    if (size != NULL) {
+        *size = data->size;
+    }
+    return data->values;
+}
+
 static void vector_free(const Vector *this, void (*free_val)(const void*)) {
     struct vector_data *data = this->data;
     if (free_val != NULL) {
@@ -103,7 +160,7 @@ const Vector *new_Vector(int capacity) {
         return NULL;
     }
     int cap = capacity > 0 ? capacity : VECTOR_CAPACITY;
-    data->capacity = data->cap_diff = cap;
+    data->capacity = cap;
     data->values = malloc(cap * sizeof(const void*));
     if (data->values == NULL) {
         free(data);
@@ -117,12 +174,16 @@ const Vector *new_Vector(int capacity) {
         return NULL;
     }
     vector->data   = data;
-    vector->append = vector_append;
-    vector->get    = vector_get;
-    vector->put    = vector_put;
-    vector->remove = vector_remove;
-    vector->size   = vector_size;
-    vector->array  = vector_array;
-    vector->free   = vector_free;
+    vector->append        = vector_append;
+    vector->append_range  = vector_append_range;
+    vector->get           = vector_get;
+    vector->put           = vector_put;
+    vector->remove        = vector_remove;
+    vector->size          = vector_size;
+    vector->reserve       = vector_reserve;
+    vector->shrink_to_fit = vector_shrink_to_fit;
+    vector->array         = vector_array;
+    vector->view          = vector_view;
+    vector->free          = vector_free;
     return vector;
 }
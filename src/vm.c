@@ -0,0 +1,81 @@
+#include "vm.h"
+#include <stdlib.h>
+#include "writer.h"
+
+/* With GCC and Clang, every handler jumps straight to the next one through
+ * a table of label addresses, which predicts far better than returning to a
+ * single switch. Other compilers get the switch. */
+#ifdef __GNUC__
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define CASE(op)   label_##op
+#define DISPATCH() __extension__ ({ goto *labels[ip->op]; })
+#else
+#define CASE(op)   case op
+#define DISPATCH() goto dispatch
+#endif
+
+static void execute(const Bytecode *program, Value *registers) {
+    const Instruction *ip = program->code.values;
+    const double *constants = program->constants.values;
+#ifdef VM_COMPUTED_GOTO
+    static const void *const labels[OP_COUNT] = {
+        [OP_HALT]   = __extension__ &&label_OP_HALT,
+        [OP_INT]    = __extension__ &&label_OP_INT,
+        [OP_DOUBLE] = __extension__ &&label_OP_DOUBLE,
+        [OP_MOVE]   = __extension__ &&label_OP_MOVE
+    };
+    DISPATCH();
+#else
+dispatch:
+    switch (ip->op) {
+#endif
+    CASE(OP_INT):
+        registers[ip->a].i = (int32_t)ip->b;
+        ip++;
+        DISPATCH();
+    CASE(OP_DOUBLE):
+        registers[ip->a].d = constants[ip->b];
+        ip++;
+        DISPATCH();
+    CASE(OP_MOVE):
+        registers[ip->a] = registers[ip->b];
+        ip++;
+        DISPATCH();
+    CASE(OP_HALT):
+        return;
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+}
+
+int run_VM(const Bytecode *program, FILE *out) {
+    const BytecodeRegisters *names = &program->registers;
+    Value *registers = calloc(names->size + 1, sizeof(*registers));
+    Writer *writer = new_Writer(out, 0);
+    if (registers == NULL || writer == NULL) {
+        free(registers);
+        if (writer != NULL) {
+            free_Writer(writer);
+        }
+        return 1;
+    }
+    execute(program, registers);
+    for (int i = 0; i < names->size; i++) {
+        if (names->values[i].name == NULL) {
+            continue;
+        }
+        writer_str(writer, names->values[i].name);
+        writer_bytes(writer, " = ", 3);
+        if (names->values[i].type == TYPE_INT) {
+            writer_int(writer, registers[i].i);
+        } else {
+            writer_double(writer, registers[i].d);
+        }
+        writer_char(writer, '\n');
+    }
+    free(registers);
+    return free_Writer(writer);
+}
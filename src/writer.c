@@ -0,0 +1,100 @@
+#include "writer.h"
+#include <stdlib.h>
+
+void writer_spill(Writer *writer, const char *bytes, size_t len) {
+    flush_Writer(writer);
+    if (len >= WRITER_BUFFER_SIZE) {
+        // Too big to be worth copying; hand it to the FILE directly
+        if (fwrite(bytes, 1, len, writer->out) != len) {
+            writer->error = 1;
+        }
+        return;
+    }
+    memcpy(writer->buf, bytes, len);
+    writer->size = len;
+}
+
+void writer_int(Writer *writer, long val) {
+    char digits[24];
+    char *end = digits + sizeof(digits), *p = end;
+    // Work with the magnitude as unsigned, so LONG_MIN doesn't overflow
+    unsigned long mag = val < 0 ? -(unsigned long)val : (unsigned long)val;
+    do {
+        *--p = '0' + mag % 10;
+        mag /= 10;
+    } while (mag != 0);
+    if (val < 0) {
+        *--p = '-';
+    }
+    writer_bytes(writer, p, end - p);
+}
+
+void writer_double(Writer *writer, double val) {
+    char digits[32];
+    int len = snprintf(digits, sizeof(digits), "%.15g", val);
+    if (strtod(digits, NULL) != val) {
+        len = snprintf(digits, sizeof(digits), "%.17g", val);
+    }
+    writer_bytes(writer, digits, len);
+}
+
+void writer_indent(Writer *writer, int level) {
+    if (writer->indent_width == 0) {
+        return;
+    }
+    size_t len = (size_t)level * writer->indent_width;
+    if (len <= WRITER_MAX_INDENT) {
+        writer_bytes(writer, writer->indentation, 1 + len);
+        return;
+    }
+    writer_char(writer, '\n');
+    for (; len > WRITER_MAX_INDENT; len -= WRITER_MAX_INDENT) {
+        writer_bytes(writer, writer->indentation + 1, WRITER_MAX_INDENT);
+    }
+    writer_bytes(writer, writer->indentation + 1, len);
+}
+
+void writer_key(Writer *writer, const char *key) {
+    writer_char(writer, '"');
+    writer_str(writer, key);
+    if (writer->indent_width == 0) {
+        writer_bytes(writer, "\":", 2);
+    } else {
+        writer_bytes(writer, "\": ", 3);
+    }
+}
+
+Writer *new_Writer(FILE *out, int indent_width) {
+    Writer *writer = malloc(sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->buf = malloc(WRITER_BUFFER_SIZE);
+    if (writer->buf == NULL) {
+        free(writer);
+        return NULL;
+    }
+    writer->out = out;
+    writer->size = 0;
+    writer->indent_width = indent_width;
+    writer->error = 0;
+    writer->indentation[0] = '\n';
+    memset(writer->indentation + 1, ' ', WRITER_MAX_INDENT);
+    return writer;
+}
+
+int flush_Writer(Writer *writer) {
+    if (writer->size > 0 &&
+        fwrite(writer->buf, 1, writer->size, writer->out) != writer->size) {
+        writer->error = 1;
+    }
+    writer->size = 0;
+    return writer->error;
+}
+
+int free_Writer(Writer *writer) {
+    int error = flush_Writer(writer);
+    free(writer->buf);
+    free(writer);
+    return error;
+}
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Usage: ast_bin_roundtrip.sh TCC INPUT
+# Writes INPUT as a binary AST, checks that dumping the binary AST gives the
+# same JSON as dumping INPUT, and that a truncated copy is rejected.
+set -e
+tcc=$1
+input=$2
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+"$tcc" --emit=ast-bin -o "$tmp/in.astb" "$input"
+"$tcc" --emit=json "$input" > "$tmp/expected.json"
+"$tcc" --emit=json "$tmp/in.astb" > "$tmp/got.json"
+cmp "$tmp/expected.json" "$tmp/got.json"
+
+head -c 100 "$tmp/in.astb" > "$tmp/bad.astb"
+if "$tcc" --emit=json "$tmp/bad.astb" > /dev/null 2>&1; then
+    echo "ast_bin_roundtrip: truncated file accepted" >&2
+    exit 1
+fi
@@ -0,0 +1,245 @@
+/* Tests for binary AST files. Builds a small flat AST, writes it out, loads
+ * it back and compares the JSON dumps of both, then checks that the loader
+ * rejects files with bad handles, offsets or cycles, and that no single
+ * flipped byte makes it accept a tree it can't walk. Exits with status 1 if
+ * any check fails. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h> // unlink()
+#include "ast_bin.h"
+
+static char path[] = "/tmp/ast_bin_test_XXXXXX";
+static int failures;
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "ast_bin_test: %s\n", what);
+        failures++;
+    }
+}
+
+// The compact JSON dump of the tree under root, or NULL
+static char *dump(const ASTFlat *flat, ASTRef root) {
+    char *text = NULL;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+    if (out == NULL) {
+        return NULL;
+    }
+    Writer *writer = new_Writer(out, 0);
+    int error = writer == NULL || json_ASTFlat(flat, root, 0, writer);
+    if (writer != NULL && free_Writer(writer)) {
+        error = 1;
+    }
+    if (fclose(out) != 0 || error) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+static int save(const void *bytes, size_t size) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        return 1;
+    }
+    int error = size > 0 && fwrite(bytes, size, 1, out) != 1;
+    return fclose(out) != 0 || error;
+}
+
+// Write flat to the test file, and read the file's bytes back into *bytes
+static int write_file(const ASTFlat *flat, ASTRef root, char **bytes,
+                      size_t *size) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        return 1;
+    }
+    int error = write_ASTBin(flat, root, out);
+    if (fclose(out) != 0 || error) {
+        return 1;
+    }
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    *size = ftell(in);
+    rewind(in);
+    *bytes = malloc(*size);
+    error = *bytes == NULL || fread(*bytes, *size, 1, in) != 1;
+    fclose(in);
+    return error;
+}
+
+// Whether loading the test file fails as malformed
+static int rejected(void) {
+    ASTBin *bin = load_ASTBin(path);
+    if (bin != NULL) {
+        free_ASTBin(bin);
+        return 0;
+    }
+    return errno == EINVAL;
+}
+
+/* The tree for
+ *   a = 1
+ *   b = a = 2.5
+ *   c = b */
+static ASTRef build(ASTFlat *flat, const Interner *interner) {
+    ASTLocation loc = {1, 1, 1, 1};
+    const Symbol *a = interner->intern(interner, "a", 1);
+    const Symbol *b = interner->intern(interner, "b", 1);
+    const Symbol *c = interner->intern(interner, "c", 1);
+    ASTRef statements[3];
+    statements[0] = flat_add_assignment(flat, &loc,
+                                        flat_add_variable(flat, &loc, a),
+                                        flat_add_int(flat, &loc, 1));
+    ASTRef inner = flat_add_assignment(flat, &loc,
+                                       flat_add_variable(flat, &loc, a),
+                                       flat_add_double(flat, &loc, 2.5));
+    statements[1] = flat_add_assignment(flat, &loc,
+                                        flat_add_variable(flat, &loc, b),
+                                        inner);
+    statements[2] = flat_add_assignment(flat, &loc,
+                                        flat_add_variable(flat, &loc, c),
+                                        flat_add_variable(flat, &loc, b));
+    return flat_add_program(flat, &loc, statements, 3);
+}
+
+static void test_round_trip(const ASTFlat *flat, ASTRef root) {
+    char *bytes;
+    size_t size;
+    if (write_file(flat, root, &bytes, &size)) {
+        check(0, "write");
+        return;
+    }
+    free(bytes);
+    ASTBin *bin = load_ASTBin(path);
+    if (bin == NULL) {
+        check(0, "load");
+        return;
+    }
+    char *expected = dump(flat, root);
+    char *got = dump(&bin->flat, bin->root);
+    check(expected != NULL && got != NULL && strcmp(expected, got) == 0,
+          "loaded tree differs");
+    free(expected);
+    free(got);
+    free_ASTBin(bin);
+}
+
+/* Write flat with one field changed, expecting the loader to reject it.
+ * The field is restored afterwards. */
+static void test_corrupt(ASTFlat *flat, ASTRef root, uint32_t *field,
+                         uint32_t val, const char *what) {
+    uint32_t saved = *field;
+    *field = val;
+    char *bytes;
+    size_t size;
+    if (write_file(flat, root, &bytes, &size)) {
+        check(0, "write");
+    } else {
+        check(rejected(), what);
+        free(bytes);
+    }
+    *field = saved;
+}
+
+static void test_bad_root(const ASTFlat *flat) {
+    char *bytes;
+    size_t size;
+    if (write_file(flat, AST_REF(AST_PROGRAM, 1), &bytes, &size)) {
+        check(0, "write");
+        return;
+    }
+    check(rejected(), "root out of range accepted");
+    free(bytes);
+}
+
+static void test_truncated(const ASTFlat *flat, ASTRef root) {
+    char *bytes;
+    size_t size;
+    if (write_file(flat, root, &bytes, &size)) {
+        check(0, "write");
+        return;
+    }
+    for (size_t cut = 0; cut < size; cut += AST_BIN_ALIGNMENT) {
+        if (save(bytes, cut)) {
+            check(0, "write");
+            break;
+        }
+        check(rejected(), "truncated file accepted");
+    }
+    free(bytes);
+}
+
+/* Flip each byte of a good file in turn. The loader may accept some of
+ * them, such as changed locations or values, but whatever it accepts must
+ * be safe to dump. */
+static void test_flipped(const ASTFlat *flat, ASTRef root) {
+    char *bytes;
+    size_t size;
+    if (write_file(flat, root, &bytes, &size)) {
+        check(0, "write");
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] ^= 0xff;
+        if (save(bytes, size)) {
+            check(0, "write");
+            break;
+        }
+        ASTBin *bin = load_ASTBin(path);
+        if (bin != NULL) {
+            free(dump(&bin->flat, bin->root));
+            free_ASTBin(bin);
+        }
+        bytes[i] ^= 0xff;
+    }
+    free(bytes);
+}
+
+int main(void) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("ast_bin_test: mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    const Arena *arena = new_Arena(0);
+    const Interner *interner = arena == NULL ? NULL : new_Interner(arena);
+    ASTFlat *flat = new_ASTFlat();
+    if (interner == NULL || flat == NULL) {
+        perror("ast_bin_test: unable to allocate memory");
+        return EXIT_FAILURE;
+    }
+    ASTRef root = build(flat, interner);
+    check(root != AST_REF_NONE, "build");
+
+    test_round_trip(flat, root);
+    test_corrupt(flat, root, &flat->children[0], AST_REF(AST_ASSIGNMENT, 9),
+                 "child out of range accepted");
+    test_corrupt(flat, root, &flat->children[0], root,
+                 "nested program accepted");
+    test_corrupt(flat, root, &flat->assignments[0].lhs, AST_REF(AST_INT, 0),
+                 "non-variable target accepted");
+    test_corrupt(flat, root, &flat->assignments[1].rhs, AST_REF(AST_DOUBLE, 5),
+                 "value out of range accepted");
+    test_corrupt(flat, root, &flat->assignments[1].rhs,
+                 AST_REF(AST_ASSIGNMENT, 2), "cycle accepted");
+    test_corrupt(flat, root, &flat->variables[0].name, flat->strings_size,
+                 "name past string table accepted");
+    test_corrupt(flat, root, &flat->programs[0].count, 4,
+                 "program past child list accepted");
+    test_bad_root(flat);
+    test_truncated(flat, root);
+    test_flipped(flat, root);
+
+    free_ASTFlat(flat);
+    interner->free(interner);
+    arena->free(arena);
+    unlink(path);
+    return failures > 0;
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Usage: backends.sh TCC DIR
+# Builds the programs in DIR with every backend, the VM (--run), C (the
+# default) and x86-64 assembly (--native), at -O0 and -O1, and checks that
+# each prints DIR/backends.out. The programs chain assignments, redefine
+# globals across files and need more registers than the native backend has.
+# Also checks that a global given another type in a later file is rejected.
+tcc=$1
+dir=$2
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+inputs="$dir/chain.t $dir/redefine_1.t $dir/redefine_2.t $dir/spill.t"
+status=0
+
+check() {
+    if ! diff -u "$dir/backends.out" "$tmp/out" > "$tmp/diff"; then
+        echo "backends: $* prints the wrong output" >&2
+        cat "$tmp/diff" >&2
+        status=1
+    fi
+}
+
+for opt in -O0 -O1; do
+    "$tcc" $opt -j2 --run $inputs > "$tmp/out" || status=1
+    check --run $opt
+    "$tcc" $opt -j2 -o "$tmp/c" $inputs && "$tmp/c" > "$tmp/out" || status=1
+    check --emit=exe $opt
+    "$tcc" $opt -j2 --native -o "$tmp/asm" $inputs &&
+        "$tmp/asm" > "$tmp/out" || status=1
+    check --native $opt
+done
+
+if "$tcc" --run "$dir/redefine_1.t" "$dir/conflict.t" > /dev/null 2>&1; then
+    echo "backends: conflicting global accepted" >&2
+    status=1
+fi
+exit $status
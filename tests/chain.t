@@ -0,0 +1,5 @@
+a = b = 2.5
+c = a
+n = m = 7
+n = m
+k = n = 40000
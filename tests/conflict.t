@@ -0,0 +1 @@
+total = 2.5
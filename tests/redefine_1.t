@@ -0,0 +1,3 @@
+x = 1.5
+total = 10
+name = total
@@ -0,0 +1,4 @@
+x = 0.1
+total = 20
+x = x
+other = total
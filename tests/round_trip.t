@@ -0,0 +1,5 @@
+a = 1
+b = x = 2.5
+c = b
+total = a = 40000
+y = x
@@ -0,0 +1,36 @@
+d0 = 0.25
+d1 = 1.25
+d2 = 2.25
+d3 = 3.25
+d4 = 4.25
+d5 = 5.25
+d6 = 6.25
+d7 = 7.25
+d8 = 8.25
+d9 = 9.25
+d10 = 10.25
+d11 = 11.25
+e0 = d11
+e1 = d10
+e2 = d9
+e3 = d8
+e4 = d7
+e5 = d6
+e6 = d5
+e7 = d4
+e8 = d3
+e9 = d2
+e10 = d1
+e11 = d0
+d0 = e0
+d1 = e1
+d2 = e2
+d3 = e3
+d4 = e4
+d5 = e5
+d6 = e6
+d7 = e7
+d8 = e8
+d9 = e9
+d10 = e10
+d11 = e11